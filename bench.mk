@@ -0,0 +1,7 @@
+.PHONY: bench
+
+bench.out: bench/bench.cpp src/*.hpp
+	$(CXX) $(CXXFLAGS) -O3 -Isrc/ bench/bench.cpp -o bench/bench.out
+
+bench: bench.out
+	./bench/bench.out
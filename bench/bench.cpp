@@ -0,0 +1,418 @@
+#include <chrono>
+#include <cstdio>
+#include "AccumulatorEngine.hpp"
+#include "oversample.hpp"
+#include "xoshiro.hpp"
+#include "distribution.hpp"
+#include "burst.hpp"
+
+// Per-sample cost of modules with mono and 16 channel polyphonic cables, printed in nanoseconds.
+// Build and run with `make bench`.
+
+static const int FRAMES = 1 << 20;
+static const float SAMPLE_TIME = 1.f / 48000.f;
+
+// The fastest of several runs, which is the least disturbed by the rest of the system
+template <typename F>
+static double measure(F process, int frames = FRAMES) {
+  double best = INFINITY;
+  for (int run = 0; run < 5; run++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+      process(frame);
+    }
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / frames);
+  }
+  return best;
+}
+
+static void patch(Input &input, int channels, float voltage) {
+  input.channels = channels;
+  for (int c = 0; c < channels; c++) {
+    input.voltages[c] = voltage + 0.01f * c;
+  }
+}
+
+// The process() functions of Accumulator and AccumulatorSingle before they shared the engine,
+// with the module's ports passed in, kept for comparison
+struct LegacyAccumulator {
+  Input *rate[2], *reset[2], *clock[2], *resetValue[2];
+  Output *sum[2], *total[2], *mean[2];
+  Input *storeInput, *recallInput, *slotInput;
+  SumBanks sums[2];
+  float channels[2] = {0};
+  int slotChannels[2][SumBanks::SLOTS] = {{0}};
+  dsp::SchmittTrigger storeTrigger;
+  dsp::SchmittTrigger recallTrigger;
+  dsp::TSchmittTrigger<simd::float_4> resetTrigger[2][4];
+  dsp::TSchmittTrigger<simd::float_4> clockTrigger[2][4];
+  bool cascade = false;
+
+  void process(float sampleTime) {
+    bool stepped[2];
+    bool reduce[2];
+    int minChannels[2];
+    int resets[2] = {0};
+    simd::float_4 total[2] = {0.f, 0.f};
+
+    bool store = storeTrigger.process(storeInput->getVoltage());
+    bool recall = recallTrigger.process(recallInput->getVoltage());
+    if (store || recall) {
+      int slot = clamp((int)std::round(slotInput->getVoltage()), 0, SumBanks::SLOTS - 1);
+      for (int i = 0; i < 2; i++) {
+        if (store) {
+          sums[i].store(slot);
+          slotChannels[i][slot] = channels[i];
+        }
+        if (recall) {
+          sums[i].recall(slot);
+          channels[i] = slotChannels[i][slot];
+        }
+      }
+    }
+
+    for (int i = 0; i < 2; i++) {
+      stepped[i] = clock[i]->isConnected();
+      reduce[i] = this->total[i]->isConnected() || mean[i]->isConnected();
+      minChannels[i] = rate[i]->getChannels();
+      if (stepped[i] && clock[i]->getChannels() > minChannels[i]) {
+        minChannels[i] = clock[i]->getChannels();
+      }
+      if (i == 1 && cascade && channels[0] > minChannels[i]) {
+        minChannels[i] = channels[0];
+      }
+      if (minChannels[i] > channels[i]) {
+        channels[i] = minChannels[i];
+      }
+    }
+
+    for (int c = 0; c < 16; c += 4) {
+      simd::float_4 sum = 0.f;
+
+      for (int i = 0; i < 2; i++) {
+        simd::float_4 rate = cascade && i == 1 ? sum : simd::float_4::zero();
+        sum = simd::float_4::load(&sums[i].current()[c]);
+
+        if (stepped[i]) {
+          simd::float_4 step = clockTrigger[i][c / 4].process(clock[i]->getPolyVoltageSimd<simd::float_4>(c));
+          if (simd::movemask(step)) {
+            sum += step & (rate + this->rate[i]->getPolyVoltageSimd<simd::float_4>(c));
+          }
+        } else {
+          sum += (rate + this->rate[i]->getVoltageSimd<simd::float_4>(c)) * sampleTime;
+        }
+
+        simd::float_4 reset = resetTrigger[i][c / 4].process(this->reset[i]->getPolyVoltageSimd<simd::float_4>(c));
+        int mask = simd::movemask(reset);
+        if (mask) {
+          sum = simd::ifelse(reset, resetValue[i]->getPolyVoltageSimd<simd::float_4>(c), sum);
+          resets[i] |= mask << c;
+        }
+
+        sum.store(&sums[i].next()[c]);
+        this->sum[i]->setVoltageSimd(sum, c);
+
+        if (reduce[i]) {
+          total[i] += (simd::float_4(c, c + 1, c + 2, c + 3) < channels[i]) & sum;
+        }
+      }
+    }
+
+    for (int i = 0; i < 2; i++) {
+      sums[i].advance();
+
+      if (reduce[i]) {
+        float totalSum = total[i][0] + total[i][1] + total[i][2] + total[i][3];
+        this->total[i]->setVoltage(totalSum);
+        mean[i]->setVoltage(channels[i] > 0 ? totalSum / channels[i] : 0.f);
+      }
+
+      if (resets[i]) {
+        if (resetValue[i]->getChannels() > minChannels[i]) {
+          minChannels[i] = resetValue[i]->getChannels();
+        }
+        if (reset[i]->isMonophonic()) {
+          channels[i] = minChannels[i];
+        } else if (channels[i] > minChannels[i] && (resets[i] & (1 << ((int)channels[i] - 1)))) {
+          channels[i]--;
+        }
+      }
+
+      if (channels[i] > 0) {
+        sum[i]->setChannels(channels[i]);
+      }
+    }
+  }
+};
+
+struct LegacyAccumulatorSingle {
+  Input *rateInput, *resetInput, *resetValueInput;
+  Input *storeInput, *recallInput, *slotInput;
+  Output *sumOutput;
+  Param *rateParam, *resetParam;
+  SumBanks sums;
+  dsp::BooleanTrigger resetButtonTrigger;
+  dsp::SchmittTrigger storeTrigger;
+  dsp::SchmittTrigger recallTrigger;
+  dsp::TSchmittTrigger<simd::float_4> resetTrigger[4];
+
+  void process(float sampleTime) {
+    sumOutput->setChannels(rateInput->getChannels());
+
+    bool store = storeTrigger.process(storeInput->getVoltage());
+    bool recall = recallTrigger.process(recallInput->getVoltage());
+    if (store || recall) {
+      int slot = clamp((int)std::round(slotInput->getVoltage()), 0, SumBanks::SLOTS - 1);
+      if (store) {
+        sums.store(slot);
+      }
+      if (recall) {
+        sums.recall(slot);
+      }
+    }
+
+    bool integrate = sumOutput->isConnected();
+    bool rateConnected = rateInput->isConnected();
+    float rate = rateParam->getValue() * sampleTime;
+    simd::float_4 resetButton = resetButtonTrigger.process(resetParam->getValue() > 0.0f) ? simd::float_4::mask() : simd::float_4::zero();
+
+    for (int c = 0; c < 16; c += 4) {
+      simd::float_4 sum = simd::float_4::load(&sums.current()[c]);
+
+      if (integrate) {
+        if (rateConnected) {
+          sum += rate * (rateInput->getVoltageSimd<simd::float_4>(c) / 5.f);
+        } else if (c == 0) {
+          sum[0] += rate;
+        }
+      }
+
+      simd::float_4 reset = resetButton | resetTrigger[c / 4].process(resetInput->getPolyVoltageSimd<simd::float_4>(c));
+      if (simd::movemask(reset)) {
+        sum = simd::ifelse(reset, resetValueInput->getPolyVoltageSimd<simd::float_4>(c), sum);
+      }
+
+      sum.store(&sums.next()[c]);
+
+      if (integrate) {
+        sumOutput->setVoltageSimd(sum, c);
+      }
+    }
+
+    sums.advance();
+  }
+};
+
+// The oversampled path of Comparator for four blocks of four channels
+struct OversampledComparator {
+  HalfBandUpsampler<simd::float_4> dUpsampler[4];
+  HalfBandDownsampler<simd::float_4> greaterDownsampler[4];
+  HalfBandDownsampler<simd::float_4> lessDownsampler[4];
+  simd::float_4 greater[4];
+  simd::float_4 less[4];
+
+  OversampledComparator(int factor) {
+    for (int i = 0; i < 4; i++) {
+      dUpsampler[i].setFactor(factor);
+      greaterDownsampler[i].setFactor(factor);
+      lessDownsampler[i].setFactor(factor);
+      greater[i] = less[i] = simd::float_4::zero();
+    }
+  }
+
+  void process(Input &a, Input &b, Output &out) {
+    int factor = dUpsampler[0].factor;
+    for (int c = 0; c < 16; c += 4) {
+      simd::float_4 dUp[8], greaterUp[8], lessUp[8];
+      dUpsampler[c / 4].process(a.getVoltageSimd<simd::float_4>(c) - b.getVoltageSimd<simd::float_4>(c), dUp);
+      for (int i = 0; i < factor; i++) {
+        greater[c / 4] = (dUp[i] > 0.1f) | (greater[c / 4] & (dUp[i] > -0.1f));
+        less[c / 4] = (dUp[i] < -0.1f) | (less[c / 4] & (dUp[i] < 0.1f));
+        greaterUp[i] = simd::ifelse(greater[c / 4], 10.0f, 0.0f);
+        lessUp[i] = simd::ifelse(less[c / 4], 10.0f, 0.0f);
+      }
+      out.setVoltageSimd(greaterDownsampler[c / 4].process(greaterUp) - lessDownsampler[c / 4].process(lessUp), c);
+    }
+  }
+};
+
+// The countdowns Spray draws for a burst of 16 voices. The random numbers are spread over the
+// burst without a bias, through one table composed from the bias and the distribution as
+// drawCountdowns() does, or with std::pow followed by the distribution table.
+struct SprayBurst {
+  enum Shape { UNIFORM, TABLE, POW };
+
+  Xoshiro128x4 rng;
+  DistributionTable burstTable;
+  const DistributionTable &spread = distributionTables()[DISTRIBUTION_UNIFORM];
+  float bias = 4.f;
+  int32_t delay[16];
+
+  SprayBurst() {
+    burstTable.fillPower(bias);
+    burstTable.compose(spread);
+  }
+
+  void process(Shape shape, float samples) {
+    if (shape == TABLE) {
+      drawCountdowns(rng, burstTable, 16, samples, delay);
+      return;
+    }
+    for (int c = 0; c < 16; c += 4) {
+      float u[4];
+      rng.uniform(u);
+      if (shape == POW) {
+        for (int lane = 0; lane < 4; lane++) {
+          u[lane] = std::pow(u[lane], bias);
+        }
+        spread.lookup(u, u);
+      }
+      simd::int32_4(simd::fmax(simd::float_4::load(u) * samples, 0.f)).store(&delay[c]);
+    }
+  }
+};
+
+// Both Accumulator variants with the rate and reset inputs patched with the given number of channels
+static void benchAccumulator(int channels) {
+  Input rate[2], reset[2], unpatched;
+  Output sum[2], total, mean, unconnected;
+  for (int i = 0; i < 2; i++) {
+    patch(rate[i], channels, 1.f);
+    patch(reset[i], channels, 0.f);
+    sum[i].channels = channels;
+  }
+  total.channels = mean.channels = 1;
+
+  LegacyAccumulator *legacyDual = new LegacyAccumulator();
+  for (int i = 0; i < 2; i++) {
+    legacyDual->rate[i] = &rate[i];
+    legacyDual->reset[i] = &reset[i];
+    legacyDual->clock[i] = legacyDual->resetValue[i] = &unpatched;
+    legacyDual->sum[i] = &sum[i];
+    legacyDual->total[i] = legacyDual->mean[i] = &unconnected;
+  }
+  legacyDual->storeInput = legacyDual->recallInput = legacyDual->slotInput = &unpatched;
+  double legacyDualTime = measure([&](int frame) {
+    for (int i = 0; i < 2; i++) {
+      reset[i].voltages[frame & (channels - 1)] = (frame & 4095) == 0 ? 10.f : 0.f;
+    }
+    legacyDual->process(SAMPLE_TIME);
+  });
+
+  AccumulatorEngine<2, false> *dual = new AccumulatorEngine<2, false>();
+  for (int i = 0; i < 2; i++) {
+    dual->ports[i].rate = &rate[i];
+    dual->ports[i].reset = &reset[i];
+    dual->ports[i].sum = &sum[i];
+  }
+  double engineDual = measure([&](int frame) {
+    for (int i = 0; i < 2; i++) {
+      reset[i].voltages[frame & (channels - 1)] = (frame & 4095) == 0 ? 10.f : 0.f;
+    }
+    dual->process(SAMPLE_TIME);
+  });
+
+  legacyDual->total[0] = dual->ports[0].total = &total;
+  legacyDual->mean[0] = dual->ports[0].mean = &mean;
+  legacyDual->cascade = dual->cascade = true;
+  double legacyDualReduce = measure([&](int frame) {
+    legacyDual->process(SAMPLE_TIME);
+  });
+  double engineDualReduce = measure([&](int frame) {
+    dual->process(SAMPLE_TIME);
+  });
+
+  Param knob, button;
+  knob.setValue(2.f);
+  LegacyAccumulatorSingle *legacySingle = new LegacyAccumulatorSingle();
+  legacySingle->rateInput = &rate[0];
+  legacySingle->resetInput = &reset[0];
+  legacySingle->resetValueInput = legacySingle->storeInput = legacySingle->recallInput = legacySingle->slotInput = &unpatched;
+  legacySingle->sumOutput = &sum[0];
+  legacySingle->rateParam = &knob;
+  legacySingle->resetParam = &button;
+  double legacyOne = measure([&](int frame) {
+    reset[0].voltages[frame & (channels - 1)] = (frame & 4095) == 0 ? 10.f : 0.f;
+    legacySingle->process(SAMPLE_TIME);
+  });
+
+  AccumulatorEngine<1, true> *single = new AccumulatorEngine<1, true>();
+  single->ports[0].rate = &rate[0];
+  single->ports[0].reset = &reset[0];
+  single->ports[0].sum = &sum[0];
+  single->ports[0].rateKnob = &knob;
+  double engineOne = measure([&](int frame) {
+    reset[0].voltages[frame & (channels - 1)] = (frame & 4095) == 0 ? 10.f : 0.f;
+    single->process(SAMPLE_TIME);
+  });
+
+  std::printf("Accumulator, 2 x %d channels\n", channels);
+  std::printf("  before the engine       %6.1f ns/sample\n", legacyDualTime);
+  std::printf("  engine                  %6.1f ns/sample\n", engineDual);
+  std::printf("  before, cascade + mean  %6.1f ns/sample\n", legacyDualReduce);
+  std::printf("  engine, cascade + mean  %6.1f ns/sample\n", engineDualReduce);
+  std::printf("AccumulatorSingle, %d channels\n", channels);
+  std::printf("  before the engine       %6.1f ns/sample\n", legacyOne);
+  std::printf("  engine                  %6.1f ns/sample\n", engineOne);
+  std::printf("  (sums %f %f %f %f)\n", legacyDual->sums[1].current()[0], dual->sums[1].current()[0], legacySingle->sums.current()[0], single->sums[0].current()[0]);
+
+  delete legacyDual;
+  delete dual;
+  delete legacySingle;
+  delete single;
+}
+
+int main() {
+  benchAccumulator(1);
+  benchAccumulator(16);
+
+  Input a, b;
+  Output gates;
+  patch(a, 16, 0.f);
+  patch(b, 16, 0.05f);
+  std::printf("Comparator oversampling, 16 channels\n");
+  for (int factor = 1; factor <= 8; factor *= 2) {
+    OversampledComparator *comparator = new OversampledComparator(factor);
+    double oversampled = measure([&](int frame) {
+      a.voltages[frame & 15] = std::sin(frame * 0.01f);
+      comparator->process(a, b, gates);
+    });
+    std::printf("  %dx                      %6.1f ns/sample\n", factor, oversampled);
+    delete comparator;
+  }
+
+  SprayBurst burst;
+  const char *shapeNames[] = {"unbiased", "composed table", "std::pow"};
+  std::printf("Spray, one burst of 16 voices\n");
+  for (int shape = SprayBurst::UNIFORM; shape <= SprayBurst::POW; shape++) {
+    double burstTime = measure([&](int frame) {
+      burst.process((SprayBurst::Shape)shape, 48000.f);
+    });
+    std::printf("  %-22s  %6.1f ns/burst\n", shapeNames[shape], burstTime);
+  }
+
+  // Refilling the burst table when the knob or the distribution changes
+  DistributionTable refill;
+  double powRefill = measure([&](int frame) {
+    float bias = 1.f + (frame & 31);
+    refill.fill([=](float u) {
+      return std::pow(u, bias);
+    });
+  }, FRAMES >> 6);
+  double exp2Refill = measure([&](int frame) {
+    refill.fillPower(1.f + (frame & 31));
+  }, FRAMES >> 6);
+  const DistributionTable &gaussian = distributionTables()[DISTRIBUTION_GAUSSIAN];
+  double composedRefill = measure([&](int frame) {
+    refill.fillPower(1.f + (frame & 31));
+    refill.compose(gaussian);
+  }, FRAMES >> 6);
+  std::printf("Spray, burst table refill\n");
+  std::printf("  std::pow                %6.1f ns\n", powRefill);
+  std::printf("  log2 table and exp2     %6.1f ns\n", exp2Refill);
+  std::printf("  composed with gaussian  %6.1f ns\n", composedRefill);
+
+  std::printf("(gate %f, delay %d, bias %f)\n", gates.voltages[0], (int)burst.delay[0], refill.values[1]);
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "plugin.hpp"
 #include "./controls.hpp"
+#include "./AccumulatorEngine.hpp"
 
 struct Accumulator : Module {
   enum ParamId {
@@ -10,26 +11,29 @@ struct Accumulator : Module {
     RESET_1_INPUT,
     RATE_2_INPUT,
     RESET_2_INPUT,
+    CLOCK_1_INPUT,
+    CLOCK_2_INPUT,
+    RESET_VALUE_1_INPUT,
+    RESET_VALUE_2_INPUT,
+    STORE_INPUT,
+    RECALL_INPUT,
+    SLOT_INPUT,
     INPUTS_LEN
   };
   enum OutputId {
     SUM_1_OUTPUT,
     SUM_2_OUTPUT,
+    TOTAL_1_OUTPUT,
+    TOTAL_2_OUTPUT,
+    MEAN_1_OUTPUT,
+    MEAN_2_OUTPUT,
     OUTPUTS_LEN
   };
   enum LightId {
     LIGHTS_LEN
   };
 
-  int rateI[2];
-  int resetI[2];
-  int sumO[2];
-
-  float sums[2][16] = {{0.0f}};
-  float channels[2] = {0};
-  dsp::BooleanTrigger resetTrigger[2][16];
-
-  bool saveSumWithPatch = true;
+  AccumulatorEngine<2, false> engine;
 
   Accumulator() {
     config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -37,106 +41,55 @@ struct Accumulator : Module {
     configInput(RATE_2_INPUT, "Growth rate");
     configInput(RESET_1_INPUT, "Reset");
     configInput(RESET_2_INPUT, "Reset");
+    configInput(CLOCK_1_INPUT, "Step clock");
+    configInput(CLOCK_2_INPUT, "Step clock");
+    configInput(RESET_VALUE_1_INPUT, "Reset value");
+    configInput(RESET_VALUE_2_INPUT, "Reset value");
+    configInput(STORE_INPUT, "Store snapshot");
+    configInput(RECALL_INPUT, "Recall snapshot");
+    configInput(SLOT_INPUT, "Snapshot slot (1V per slot)");
     configOutput(SUM_1_OUTPUT, "Total");
     configOutput(SUM_2_OUTPUT, "Total");
-
-    rateI[0] = RATE_1_INPUT;
-    rateI[1] = RATE_2_INPUT;
-    resetI[0] = RESET_1_INPUT;
-    resetI[1] = RESET_2_INPUT;
-    sumO[0] = SUM_1_OUTPUT;
-    sumO[1] = SUM_2_OUTPUT;
+    configOutput(TOTAL_1_OUTPUT, "Sum of all channels");
+    configOutput(TOTAL_2_OUTPUT, "Sum of all channels");
+    configOutput(MEAN_1_OUTPUT, "Mean of all channels");
+    configOutput(MEAN_2_OUTPUT, "Mean of all channels");
+
+    engine.ports[0].rate = &inputs[RATE_1_INPUT];
+    engine.ports[0].reset = &inputs[RESET_1_INPUT];
+    engine.ports[0].clock = &inputs[CLOCK_1_INPUT];
+    engine.ports[0].resetValue = &inputs[RESET_VALUE_1_INPUT];
+    engine.ports[0].sum = &outputs[SUM_1_OUTPUT];
+    engine.ports[0].total = &outputs[TOTAL_1_OUTPUT];
+    engine.ports[0].mean = &outputs[MEAN_1_OUTPUT];
+    engine.ports[1].rate = &inputs[RATE_2_INPUT];
+    engine.ports[1].reset = &inputs[RESET_2_INPUT];
+    engine.ports[1].clock = &inputs[CLOCK_2_INPUT];
+    engine.ports[1].resetValue = &inputs[RESET_VALUE_2_INPUT];
+    engine.ports[1].sum = &outputs[SUM_2_OUTPUT];
+    engine.ports[1].total = &outputs[TOTAL_2_OUTPUT];
+    engine.ports[1].mean = &outputs[MEAN_2_OUTPUT];
+    engine.storeInput = &inputs[STORE_INPUT];
+    engine.recallInput = &inputs[RECALL_INPUT];
+    engine.slotInput = &inputs[SLOT_INPUT];
   }
 
   json_t *dataToJson() override {
     json_t *rootJ = json_object();
-    json_t *configsJ = json_array();
-    for (size_t i = 0; i < 2; i++) {
-      json_t *sumJ = json_object();
-      json_array_append_new(configsJ, sumJ);
-      json_t *sumsJ = json_array();
-      for (size_t c = 0; c < channels[i]; c++) {
-        json_array_append_new(sumsJ, json_real(sums[i][c]));
-      }
-      json_object_set_new(sumJ, "sums", sumsJ);
-    }
-    json_object_set_new(rootJ, "accumulators", configsJ);
-    json_object_set_new(rootJ, "saveSumWithPatch", json_boolean(saveSumWithPatch));
+    engine.dataToJson(rootJ);
     return rootJ;
   }
 
   void dataFromJson(json_t *root) override {
-
-    json_t *saveSumWithPatchJson = json_object_get(root, "saveSumWithPatch");
-    if (saveSumWithPatchJson)
-      saveSumWithPatch = json_boolean_value(saveSumWithPatchJson);
-    // Only load sum values if menu option is set
-    if (saveSumWithPatch) {
-      json_t *configsJ = json_object_get(root, "accumulators");
-      if (configsJ) {
-        size_t i;
-        json_t *configJ;
-        json_array_foreach(configsJ, i, configJ) {
-          json_t *sumsJ = json_object_get(configJ, "sums");
-          if (sumsJ) {
-            size_t c;
-            json_t *sumJ;
-            json_array_foreach(sumsJ, c, sumJ) {
-              sums[i][c] = json_number_value(sumJ);
-              channels[i] = c;
-            }
-          }
-        }
-      }
-    }
+    engine.dataFromJson(root);
   }
 
   void process(const ProcessArgs &args) override {
-    for (int i = 0; i < 2; i++) {
-      if (inputs[rateI[i]].getChannels() > channels[i]) {
-        channels[i] = inputs[rateI[i]].getChannels();
-      }
-
-      if (channels[i] == 0) {
-        return;
-      }
-
-      outputs[sumO[i]].setChannels(channels[i]);
-
-      for (int c = 0; c < channels[i]; c++) {
-        sums[i][c] += inputs[rateI[i]].getVoltage(c) * args.sampleTime;
-        outputs[sumO[i]].setVoltage(sums[i][c], c);
-      }
-
-      if (inputs[resetI[i]].isMonophonic()) {
-        if (resetTrigger[i][0].process(inputs[resetI[i]].getVoltage() > 0.0f)) {
-          for (int c = 0; c < 16; c++) {
-            sums[i][c] = 0.0f;
-          }
-          channels[i] = 0;
-        }
-      }
-
-      if (inputs[resetI[i]].isPolyphonic()) {
-        for (int c = 0; c < inputs[resetI[i]].getChannels(); c++) {
-          if (resetTrigger[i][c].process(inputs[resetI[i]].getVoltage(c) > 0.0f)) {
-            sums[i][c] = 0.0f;
-            if (c == channels[i] - 1) {
-              channels[i]--;
-            }
-          }
-        }
-      }
-    }
+    engine.process(args.sampleTime);
   }
 
   void onReset() override {
-    for (int i = 0; i < 2; i++) {
-      for (int c = 0; c < 16; c++) {
-        channels[i] = 0;
-        sums[i][c] = 0.0f;
-      }
-    }
+    engine.reset();
   }
 };
 
@@ -155,9 +108,20 @@ struct AccumulatorWidget : ModuleWidget {
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 39.429)), module, Accumulator::RESET_1_INPUT));
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 76.429)), module, Accumulator::RATE_2_INPUT));
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 94.929)), module, Accumulator::RESET_2_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 20.929)), module, Accumulator::CLOCK_1_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 76.429)), module, Accumulator::CLOCK_2_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 39.429)), module, Accumulator::RESET_VALUE_1_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 94.929)), module, Accumulator::RESET_VALUE_2_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(38.1, 20.929)), module, Accumulator::STORE_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(38.1, 39.429)), module, Accumulator::RECALL_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(38.1, 76.429)), module, Accumulator::SLOT_INPUT));
 
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 56.857)), module, Accumulator::SUM_1_OUTPUT));
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 112.357)), module, Accumulator::SUM_2_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(22.86, 56.857)), module, Accumulator::TOTAL_1_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(22.86, 112.357)), module, Accumulator::TOTAL_2_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(38.1, 56.857)), module, Accumulator::MEAN_1_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(38.1, 112.357)), module, Accumulator::MEAN_2_OUTPUT));
   }
 
   void appendContextMenu(Menu *menu) override {
@@ -166,11 +130,12 @@ struct AccumulatorWidget : ModuleWidget {
     menu->addChild(createBoolMenuItem(
         "Save sum with patch", "",
         [=]() {
-          return module->saveSumWithPatch;
+          return module->engine.saveSumWithPatch;
         },
         [=](bool value) {
-          module->saveSumWithPatch = value;
+          module->engine.saveSumWithPatch = value;
         }));
+    menu->addChild(createBoolPtrMenuItem("Cascade section 1 into section 2", "", &module->engine.cascade));
   }
 };
 
@@ -0,0 +1,376 @@
+#pragma once
+#include "plugin.hpp"
+#include "SumBanks.hpp"
+
+// Shared integration, reset, snapshot and JSON logic for the Accumulator modules.
+//
+// Sections is the number of independent accumulators. With HasAttenuverter a rate knob scales the
+// rate input (or drives the first channel on its own) and a reset button clears every channel.
+// Both are template arguments, so the branches that depend on them fold away at compile time.
+template <int Sections, bool HasAttenuverter>
+struct AccumulatorEngine {
+  struct SectionPorts {
+    Input *rate;
+    Input *reset;
+    Input *clock;
+    Input *resetValue;
+    Output *sum;
+    Output *total;
+    Output *mean;
+    Param *rateKnob;
+    Param *resetButton;
+  };
+
+  SectionPorts ports[Sections];
+  Input *storeInput;
+  Input *recallInput;
+  Input *slotInput;
+
+  SumBanks sums[Sections];
+  int channels[Sections] = {0};
+  int slotChannels[Sections][SumBanks::SLOTS] = {{0}};
+  dsp::SchmittTrigger storeTrigger;
+  dsp::SchmittTrigger recallTrigger;
+  dsp::BooleanTrigger resetButtonTrigger[Sections];
+  dsp::TSchmittTrigger<simd::float_4> resetTrigger[Sections][4];
+  dsp::TSchmittTrigger<simd::float_4> clockTrigger[Sections][4];
+
+  bool saveSumWithPatch = true;
+  bool cascade = false;
+
+  // Ports a module doesn't have stay pointed at these, which are never connected
+  Input unpatchedInput;
+  Output unpatchedOutput;
+  Param unpatchedParam;
+
+  AccumulatorEngine() {
+    for (int i = 0; i < Sections; i++) {
+      ports[i] = {&unpatchedInput, &unpatchedInput, &unpatchedInput, &unpatchedInput,
+                  &unpatchedOutput, &unpatchedOutput, &unpatchedOutput,
+                  &unpatchedParam, &unpatchedParam};
+    }
+    storeInput = recallInput = slotInput = &unpatchedInput;
+  }
+
+  // The rate of a section is its rate voltages times a scale, plus an offset in the first channel
+  void getRateScale(int i, float *scale, float *offset) {
+    *scale = 1.f;
+    *offset = 0.f;
+    if (HasAttenuverter) {
+      // The single section holds its sums while its sum output is unpatched
+      if (!ports[i].sum->isConnected()) {
+        *scale = 0.f;
+        return;
+      }
+      float knob = ports[i].rateKnob->getValue();
+      // Rate knob acts as an attenuverter if rate input is connected
+      if (ports[i].rate->isConnected()) {
+        *scale = knob / 5.f;
+      }
+      // Rate knob controls the first channel if the rate input is not connected
+      else {
+        *scale = 0.f;
+        *offset = knob;
+      }
+    }
+  }
+
+  simd::float_4 getRate(int i, int c, bool stepped, float scale, float offset) {
+    // A stepped section may be driven by a polyphonic clock from a mono rate
+    simd::float_4 rate = stepped ? ports[i].rate->template getPolyVoltageSimd<simd::float_4>(c) : ports[i].rate->template getVoltageSimd<simd::float_4>(c);
+    if (HasAttenuverter) {
+      rate *= scale;
+      if (c == 0) {
+        rate += simd::float_4(offset, 0.f, 0.f, 0.f);
+      }
+    }
+    return rate;
+  }
+
+  // What a section does on this sample, worked out once before its blocks of four channels
+  struct SectionState {
+    bool stepped;
+    bool reduce;
+    int active;
+    int resets;
+    const float *current;
+    float *next;
+    float rateScale;
+    float rateOffset;
+    float channels;
+    simd::float_4 resetButton;
+    simd::float_4 total;
+  };
+
+  // The template arguments leave the branches a sample doesn't need out of the loop. MayStep and
+  // MayReduce are false when no section has a clock, or a total or mean output. Cascade is the
+  // cascade option, and AllBlocks processes all four blocks with a count the compiler can unroll.
+  template <bool MayStep, bool MayReduce, bool Cascade, bool AllBlocks>
+  void processBlocks(SectionState *state, int activeMax, float sampleTime) {
+    // All sections are processed in the same pass so a cascaded section integrates the sum the
+    // previous section produced on this sample, without the delay of a patch cable.
+    for (int c = 0; c < (AllBlocks ? 16 : activeMax); c += 4) {
+      simd::float_4 sum = 0.f;
+
+      for (int i = 0; i < Sections; i++) {
+        simd::float_4 rate = Cascade && i > 0 ? sum : simd::float_4::zero();
+        sum = simd::float_4::load(&state[i].current[c]);
+
+        if (MayStep && state[i].stepped) {
+          // Add the rate voltage once per clock edge. Between edges only the triggers are evaluated.
+          simd::float_4 step = clockTrigger[i][c / 4].process(ports[i].clock->template getPolyVoltageSimd<simd::float_4>(c));
+          if (simd::movemask(step)) {
+            sum += step & (rate + getRate(i, c, true, state[i].rateScale, state[i].rateOffset));
+          }
+        } else {
+          sum += (rate + getRate(i, c, false, state[i].rateScale, state[i].rateOffset)) * sampleTime;
+        }
+
+        // A mono reset is broadcast to every channel. Reset channels take the reset value, or zero if it is disconnected.
+        simd::float_4 reset = resetTrigger[i][c / 4].process(ports[i].reset->template getPolyVoltageSimd<simd::float_4>(c));
+        if (HasAttenuverter) {
+          reset = reset | state[i].resetButton;
+        }
+        int mask = simd::movemask(reset);
+        if (mask) {
+          sum = simd::ifelse(reset, ports[i].resetValue->template getPolyVoltageSimd<simd::float_4>(c), sum);
+          state[i].resets |= mask << c;
+        }
+
+        sum.store(&state[i].next[c]);
+        ports[i].sum->setVoltageSimd(sum, c);
+
+        if (MayReduce && state[i].reduce) {
+          state[i].total += (simd::float_4(c, c + 1, c + 2, c + 3) < state[i].channels) & sum;
+        }
+      }
+    }
+  }
+
+  template <bool MayReduce, bool Cascade>
+  void processFreeRunning(SectionState *state, int activeMax, float sampleTime) {
+    if (activeMax > 12) {
+      processBlocks<false, MayReduce, Cascade, true>(state, activeMax, sampleTime);
+    } else {
+      processBlocks<false, MayReduce, Cascade, false>(state, activeMax, sampleTime);
+    }
+  }
+
+  void process(float sampleTime) {
+    SectionState state[Sections];
+    int minChannels[Sections];
+    int activeMax = 0;
+    bool anyStepped = false;
+    bool anyReduce = false;
+
+    // Snapshots hold the sums of the previous sample. A recalled slot is accumulated from on this sample.
+    bool store = storeTrigger.process(storeInput->getVoltage());
+    bool recall = recallTrigger.process(recallInput->getVoltage());
+    if (store || recall) {
+      int slot = clamp((int)std::round(slotInput->getVoltage()), 0, SumBanks::SLOTS - 1);
+      for (int i = 0; i < Sections; i++) {
+        if (store) {
+          sums[i].store(slot);
+          slotChannels[i][slot] = channels[i];
+        }
+        if (recall) {
+          sums[i].recall(slot);
+          channels[i] = slotChannels[i][slot];
+        }
+      }
+    }
+
+    for (int i = 0; i < Sections; i++) {
+      state[i].stepped = ports[i].clock->isConnected();
+      state[i].reduce = ports[i].total->isConnected() || ports[i].mean->isConnected();
+      anyStepped = anyStepped || state[i].stepped;
+      anyReduce = anyReduce || state[i].reduce;
+      state[i].total = 0.f;
+      state[i].resets = 0;
+      state[i].current = sums[i].current();
+      state[i].next = sums[i].next();
+      getRateScale(i, &state[i].rateScale, &state[i].rateOffset);
+
+      if (HasAttenuverter) {
+        state[i].resetButton = resetButtonTrigger[i].process(ports[i].resetButton->getValue() > 0.f) ? simd::float_4::mask() : simd::float_4::zero();
+      }
+
+      // Channels stay open while a rate, clock or reset value cable needs them.
+      // A polyphonic clock steps each channel independently, even from a mono rate.
+      minChannels[i] = ports[i].rate->getChannels();
+      if (HasAttenuverter && minChannels[i] < 1) {
+        minChannels[i] = 1;
+      }
+      if (state[i].stepped && ports[i].clock->getChannels() > minChannels[i]) {
+        minChannels[i] = ports[i].clock->getChannels();
+      }
+      if (Sections > 1 && i > 0 && cascade && channels[i - 1] > minChannels[i]) {
+        minChannels[i] = channels[i - 1];
+      }
+
+      if (minChannels[i] > channels[i]) {
+        channels[i] = minChannels[i];
+      }
+      state[i].channels = channels[i];
+
+      // Only the blocks of four channels that are in use, or that a polyphonic reset can reach, are
+      // processed. The sums of the other channels are left as they are.
+      state[i].active = std::max(std::max(channels[i], ports[i].reset->getChannels()), 1);
+      activeMax = std::max(activeMax, state[i].active);
+    }
+
+    // Clocked sections are rare enough to share one loop with every branch left in
+    bool cascaded = Sections > 1 && cascade;
+    if (anyStepped) {
+      if (cascaded) {
+        processBlocks<true, true, Sections != 1, false>(state, activeMax, sampleTime);
+      } else {
+        processBlocks<true, true, false, false>(state, activeMax, sampleTime);
+      }
+    } else if (cascaded) {
+      if (anyReduce) {
+        processFreeRunning<true, Sections != 1>(state, activeMax, sampleTime);
+      } else {
+        processFreeRunning<false, Sections != 1>(state, activeMax, sampleTime);
+      }
+    } else {
+      if (anyReduce) {
+        processFreeRunning<true, false>(state, activeMax, sampleTime);
+      } else {
+        processFreeRunning<false, false>(state, activeMax, sampleTime);
+      }
+    }
+
+    for (int i = 0; i < Sections; i++) {
+      int processed = (activeMax + 3) / 4 * 4;
+      if (state[i].resets) {
+        // A mono reset or the reset button resets the unprocessed channels too
+        bool resetAll = ports[i].reset->getChannels() == 1 || (HasAttenuverter && simd::movemask(state[i].resetButton));
+        if (resetAll && processed < 16 && state[i].resets == (1 << processed) - 1) {
+          for (int c = processed; c < 16; c += 4) {
+            ports[i].resetValue->template getPolyVoltageSimd<simd::float_4>(c).store(&state[i].next[c]);
+          }
+          state[i].resets = 0xffff;
+          processed = 16;
+        }
+      }
+      sums[i].advance(processed);
+
+      if (state[i].reduce) {
+        float totalSum = state[i].total[0] + state[i].total[1] + state[i].total[2] + state[i].total[3];
+        ports[i].total->setVoltage(totalSum);
+        ports[i].mean->setVoltage(channels[i] > 0 ? totalSum / state[i].channels : 0.f);
+      }
+
+      if (state[i].resets) {
+        if (ports[i].resetValue->getChannels() > minChannels[i]) {
+          minChannels[i] = ports[i].resetValue->getChannels();
+        }
+        if (state[i].resets == 0xffff) {
+          channels[i] = minChannels[i];
+        } else if (channels[i] > minChannels[i] && (state[i].resets & (1 << (channels[i] - 1)))) {
+          channels[i]--;
+        }
+      }
+
+      if (channels[i] > 0) {
+        ports[i].sum->setChannels(channels[i]);
+      }
+    }
+  }
+
+  void reset() {
+    for (int i = 0; i < Sections; i++) {
+      channels[i] = 0;
+      sums[i].reset();
+      for (int slot = 0; slot < SumBanks::SLOTS; slot++) {
+        slotChannels[i][slot] = 0;
+      }
+    }
+  }
+
+  void dataToJson(json_t *rootJ) {
+    json_t *configsJ = json_array();
+    for (size_t i = 0; i < Sections; i++) {
+      json_t *sumJ = json_object();
+      json_array_append_new(configsJ, sumJ);
+      json_t *sumsJ = json_array();
+      for (int c = 0; c < channels[i]; c++) {
+        json_array_append_new(sumsJ, json_real(sums[i].current()[c]));
+      }
+      json_object_set_new(sumJ, "sums", sumsJ);
+      json_t *slotsJ = json_array();
+      for (int slot = 0; slot < SumBanks::SLOTS; slot++) {
+        json_t *slotJ = json_array();
+        for (int c = 0; c < slotChannels[i][slot]; c++) {
+          json_array_append_new(slotJ, json_real(sums[i].slot(slot)[c]));
+        }
+        json_array_append_new(slotsJ, slotJ);
+      }
+      json_object_set_new(sumJ, "slots", slotsJ);
+    }
+    json_object_set_new(rootJ, "accumulators", configsJ);
+    json_object_set_new(rootJ, "saveSumWithPatch", json_boolean(saveSumWithPatch));
+    if (Sections > 1) {
+      json_object_set_new(rootJ, "cascade", json_boolean(cascade));
+    }
+  }
+
+  void dataFromJson(json_t *root) {
+    json_t *saveSumWithPatchJson = json_object_get(root, "saveSumWithPatch");
+    if (saveSumWithPatchJson)
+      saveSumWithPatch = json_boolean_value(saveSumWithPatchJson);
+    json_t *cascadeJ = json_object_get(root, "cascade");
+    if (cascadeJ)
+      cascade = json_boolean_value(cascadeJ);
+    // Only load sum values if menu option is set
+    if (saveSumWithPatch) {
+      json_t *configsJ = json_object_get(root, "accumulators");
+      if (configsJ) {
+        size_t i;
+        json_t *configJ;
+        json_array_foreach(configsJ, i, configJ) {
+          if (i >= Sections)
+            break;
+          loadSection(i, json_object_get(configJ, "sums"), json_object_get(configJ, "slots"));
+        }
+      }
+      // Patches saved before the engine was shared keep a single section at the top level,
+      // and always stored 16 channels, so the channel count is left to follow the rate input.
+      else if (Sections == 1) {
+        loadSection(0, json_object_get(root, "sums"), NULL);
+        channels[0] = 0;
+      }
+    }
+  }
+
+  void loadSection(int i, json_t *sumsJ, json_t *slotsJ) {
+    if (sumsJ) {
+      size_t c;
+      json_t *sumJ;
+      float *edit = sums[i].edit();
+      json_array_foreach(sumsJ, c, sumJ) {
+        if (c >= 16)
+          break;
+        edit[c] = json_number_value(sumJ);
+        channels[i] = c + 1;
+      }
+    }
+    if (slotsJ) {
+      size_t slot;
+      json_t *slotJ;
+      json_array_foreach(slotsJ, slot, slotJ) {
+        if (slot >= SumBanks::SLOTS)
+          break;
+        size_t c;
+        json_t *sumJ;
+        json_array_foreach(slotJ, c, sumJ) {
+          if (c >= 16)
+            break;
+          sums[i].slot(slot)[c] = json_number_value(sumJ);
+          slotChannels[i][slot] = c + 1;
+        }
+      }
+    }
+  }
+};
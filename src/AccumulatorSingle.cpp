@@ -1,5 +1,6 @@
 #include "plugin.hpp"
 #include "controls.hpp"
+#include "AccumulatorEngine.hpp"
 
 struct AccumulatorSingle : Module {
   enum ParamId {
@@ -10,6 +11,10 @@ struct AccumulatorSingle : Module {
   enum InputId {
     RATE_INPUT,
     RESET_INPUT,
+    RESET_VALUE_INPUT,
+    STORE_INPUT,
+    RECALL_INPUT,
+    SLOT_INPUT,
     INPUTS_LEN
   };
   enum OutputId {
@@ -20,10 +25,7 @@ struct AccumulatorSingle : Module {
     LIGHTS_LEN
   };
 
-  float sums[16] = {0.0f};
-  dsp::BooleanTrigger resetButtonTrigger;
-  dsp::BooleanTrigger resetTrigger[16];
-  bool saveSumWithPatch = true;
+  AccumulatorEngine<1, true> engine;
 
   AccumulatorSingle() {
     config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -31,75 +33,39 @@ struct AccumulatorSingle : Module {
     configParam(RESET_PARAM, 0.f, 1.f, 0.f, "Reset");
     configInput(RATE_INPUT, "Rate attenuverter");
     configInput(RESET_INPUT, "Reset");
+    configInput(RESET_VALUE_INPUT, "Reset value");
+    configInput(STORE_INPUT, "Store snapshot");
+    configInput(RECALL_INPUT, "Recall snapshot");
+    configInput(SLOT_INPUT, "Snapshot slot (1V per slot)");
     configOutput(SUM_OUTPUT, "Sum");
+
+    engine.ports[0].rate = &inputs[RATE_INPUT];
+    engine.ports[0].reset = &inputs[RESET_INPUT];
+    engine.ports[0].resetValue = &inputs[RESET_VALUE_INPUT];
+    engine.ports[0].sum = &outputs[SUM_OUTPUT];
+    engine.ports[0].rateKnob = &params[RATE_PARAM];
+    engine.ports[0].resetButton = &params[RESET_PARAM];
+    engine.storeInput = &inputs[STORE_INPUT];
+    engine.recallInput = &inputs[RECALL_INPUT];
+    engine.slotInput = &inputs[SLOT_INPUT];
   }
 
   void process(const ProcessArgs &args) override {
-    getOutput(SUM_OUTPUT).setChannels(getInput(RATE_INPUT).getChannels());
-
-    if (getOutput(SUM_OUTPUT).isConnected()) {
-      // Rate knob acts as an attenuverter if rate input is connected
-      if (getInput(RATE_INPUT).isConnected()) {
-        for (int c = 0; c < getInput(RATE_INPUT).getChannels(); c++) {
-          sums[c] += getParam(RATE_PARAM).getValue() * args.sampleTime * (getInput(RATE_INPUT).getVoltage(c) / 5.f);
-          getOutput(SUM_OUTPUT).setVoltage(sums[c], c);
-        }
-      }
-      // Rate knob controls the first channel if the rate input is connected
-      else {
-        sums[0] += getParam(RATE_PARAM).getValue() * args.sampleTime;
-        getOutput(SUM_OUTPUT).setVoltage(sums[0]);
-      }
-    }
-
-    if (resetButtonTrigger.process(getParam(RESET_PARAM).getValue() > 0.0f)) {
-      for (int c = 0; c < 16; c++) {
-        sums[c] = 0.0f;
-      }
-    }
-
-    if (getInput(RESET_INPUT).isPolyphonic()) {
-      for (int c = 0; c < getInput(RESET_INPUT).getChannels(); c++) {
-        if (resetTrigger[c].process(getInput(RESET_INPUT).getVoltage(c) > 0.0f)) {
-          sums[c] = 0.0f;
-        }
-      }
-    } else {
-      if (resetTrigger[0].process(getInput(RESET_INPUT).getVoltage() > 0.0f)) {
-        for (int c = 0; c < 16; c++) {
-          sums[c] = 0.0f;
-        }
-      }
-    }
+    engine.process(args.sampleTime);
   }
 
   json_t *dataToJson() override {
     json_t *rootJ = json_object();
-    json_t *sumsJ = json_array();
-    for (size_t c = 0; c < 16; c++) {
-      json_array_append_new(sumsJ, json_real(sums[c]));
-    }
-    json_object_set_new(rootJ, "sums", sumsJ);
-    json_object_set_new(rootJ, "saveSumWithPatch", json_boolean(saveSumWithPatch));
+    engine.dataToJson(rootJ);
     return rootJ;
   }
 
   void dataFromJson(json_t *root) override {
-    json_t *saveSumWithPatchJson = json_object_get(root, "saveSumWithPatch");
-    if (saveSumWithPatchJson) {
-      saveSumWithPatch = json_boolean_value(saveSumWithPatchJson);
-      // Only load sum values if menu option is set
-      if (saveSumWithPatch) {
-        json_t *sumsJ = json_object_get(root, "sums");
-        if (sumsJ) {
-          size_t c;
-          json_t *sumJ;
-          json_array_foreach(sumsJ, c, sumJ) {
-            sums[c] = json_number_value(sumJ);
-          }
-        }
-      }
-    }
+    engine.dataFromJson(root);
+  }
+
+  void onReset() override {
+    engine.reset();
   }
 };
 
@@ -118,6 +84,10 @@ struct AccumulatorSingleWidget : ModuleWidget {
 
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 46.859)), module, AccumulatorSingle::RATE_INPUT));
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 84.938)), module, AccumulatorSingle::RESET_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 84.938)), module, AccumulatorSingle::RESET_VALUE_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 34.159)), module, AccumulatorSingle::SLOT_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 46.859)), module, AccumulatorSingle::STORE_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 71.729)), module, AccumulatorSingle::RECALL_INPUT));
 
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 112.357)), module, AccumulatorSingle::SUM_OUTPUT));
   }
@@ -128,10 +98,10 @@ struct AccumulatorSingleWidget : ModuleWidget {
     menu->addChild(createBoolMenuItem(
         "Save sum with patch", "",
         [=]() {
-          return module->saveSumWithPatch;
+          return module->engine.saveSumWithPatch;
         },
         [=](bool value) {
-          module->saveSumWithPatch = value;
+          module->engine.saveSumWithPatch = value;
         }));
   }
 };
@@ -1,103 +1,447 @@
 #include <limits>
 #include "plugin.hpp"
 #include "./controls.hpp"
+#include "./oversample.hpp"
+#include "./zones.hpp"
 
 struct Comparator : Module {
   enum ParamId {
     A_PARAM,
+    TOLERANCE_PARAM,
     PARAMS_LEN
   };
   enum InputId {
     A_INPUT,
     B_INPUT,
+    TOLERANCE_INPUT,
     INPUTS_LEN
   };
   enum OutputId {
     GREATER_OUTPUT,
     EQUAL_OUTPUT,
     LESS_OUTPUT,
+    ZONE_OUTPUT,
+    ZONES_OUTPUT,
+    RISE_OUTPUT,
+    FALL_OUTPUT,
+    OFFSET_OUTPUT,
     OUTPUTS_LEN
   };
   enum LightId {
     LIGHTS_LEN
   };
 
-  float tolerance = 0.f;
+  enum AntiAliasing {
+    ANTI_ALIASING_OFF,
+    ANTI_ALIASING_MINBLEP,
+    ANTI_ALIASING_2X,
+    ANTI_ALIASING_4X,
+    ANTI_ALIASING_8X
+  };
+
+  enum Polyphony {
+    POLYPHONY_MAX,
+    POLYPHONY_MIN,
+    POLYPHONY_A,
+    POLYPHONY_B,
+    POLYPHONY_CYCLE
+  };
+
+  // Where each output channel reads an input from. Resolved when channel counts or the policy
+  // change, so the compare loop doesn't check for monophonic inputs on every sample.
+  struct Routing {
+    enum Mode {
+      DIRECT,
+      BROADCAST,
+      TABLE
+    };
+
+    Mode mode = DIRECT;
+    int index[16];
+
+    void resolve(int inputChannels, int channels, bool cycle) {
+      if (inputChannels <= 1) {
+        mode = BROADCAST;
+      } else if (inputChannels >= channels || !cycle) {
+        // Channels past the end of the input read as 0V
+        mode = DIRECT;
+      } else {
+        mode = TABLE;
+        for (int c = 0; c < 16; c++) {
+          index[c] = c % inputChannels;
+        }
+      }
+    }
+
+    simd::float_4 load(const float *voltages, int c) const {
+      switch (mode) {
+        case BROADCAST:
+          return simd::float_4(voltages[0]);
+        case TABLE:
+          return simd::float_4(voltages[index[c]], voltages[index[c + 1]], voltages[index[c + 2]], voltages[index[c + 3]]);
+        default:
+          return simd::float_4::load(&voltages[c]);
+      }
+    }
+  };
+
+  float hysteresis = 0.f;
+  int antiAliasing = ANTI_ALIASING_OFF;
+  int polyphony = POLYPHONY_MAX;
+
+  Routing aRouting;
+  Routing bRouting;
+  int channels = 0;
+  int routedA = -1;
+  int routedB = -1;
+  int routedPolyphony = -1;
+
+  // Tolerance is smoothed per channel and only updated every few samples. Channels from
+  // toleranceChannels on haven't been smoothed yet, and start at their tolerance.
+  dsp::ClockDivider toleranceDivider;
+  dsp::TExponentialFilter<simd::float_4> toleranceFilter[4];
+  int toleranceChannels = 0;
+
+  // Comparison state of each channel, kept so that hysteresis can hold an output near its threshold
+  simd::float_4 greater[4];
+  simd::float_4 less[4];
+
+  // A - B on the previous sample, for finding where between samples it crossed a threshold
+  simd::float_4 dPrev[4];
+
+  // Channels from primedChannels on have no comparison from the previous sample yet, so they take
+  // this sample's instead of crossing from 0V
+  int primedChannels = 0;
+
+  // Remaining time of the crossing triggers, and the offset of the latest crossing
+  simd::float_4 riseTime[4];
+  simd::float_4 fallTime[4];
+  simd::float_4 offset[4];
+
+  // Band-limited step corrections for each of the gate outputs
+  dsp::MinBlepGenerator<16, 16, simd::float_4> blep[3][4];
+
+  // Oversampling filters for A - B and the greater and less gates. Hysteresis at the higher rate
+  // keeps its own state, so the crossing outputs always follow the comparison at the sample rate.
+  simd::float_4 oversampledGreater[4];
+  simd::float_4 oversampledLess[4];
+  HalfBandUpsampler<simd::float_4> dUpsampler[4];
+  HalfBandDownsampler<simd::float_4> greaterDownsampler[4];
+  HalfBandDownsampler<simd::float_4> lessDownsampler[4];
+
+  // The oversampled gates come out of the filters late, so the crossing outputs are delayed by the
+  // nearest whole number of samples to stay in line with them. The history is always written, so
+  // it is ready whenever the factor changes.
+  static const int CROSSING_HISTORY = 32;
+  simd::float_4 crossingHistory[CROSSING_HISTORY][3][4];
+  int crossingPos = 0;
 
   Comparator() {
     config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
     configParam(A_PARAM, -10.0f, 10.0f, 0.0f, "A", "V");
+    configParam(TOLERANCE_PARAM, 0.0f, 1.0f, 0.0f, "A = B tolerance", "V");
     configInput(A_INPUT, "A override");
     configInput(B_INPUT, "B");
+    configInput(TOLERANCE_INPUT, "Tolerance CV (1V per 10V)");
     configOutput(LESS_OUTPUT, "A less than B");
     configOutput(EQUAL_OUTPUT, "A equal to B");
     configOutput(GREATER_OUTPUT, "A greater than B");
+    configOutput(ZONE_OUTPUT, "Zone of A between B thresholds (1V per zone)");
+    configOutput(ZONES_OUTPUT, "Zone gates");
+    configOutput(RISE_OUTPUT, "A rose above B");
+    configOutput(FALL_OUTPUT, "A fell below B");
+    configOutput(OFFSET_OUTPUT, "Crossing offset before the sample (10V per sample)");
+
+    for (int i = 0; i < 4; i++) {
+      greater[i] = less[i] = dPrev[i] = simd::float_4::zero();
+      oversampledGreater[i] = oversampledLess[i] = simd::float_4::zero();
+      riseTime[i] = fallTime[i] = offset[i] = simd::float_4::zero();
+      for (int j = 0; j < CROSSING_HISTORY; j++) {
+        for (int k = 0; k < 3; k++) {
+          crossingHistory[j][k][i] = simd::float_4::zero();
+        }
+      }
+      toleranceFilter[i].setTau(0.005f);
+    }
+    toleranceDivider.setDivision(16);
+  }
+
+  void onReset() override {
+    toleranceChannels = 0;
+    primedChannels = 0;
   }
 
   json_t *dataToJson() override {
     json_t *root = json_object();
-    json_object_set_new(root, "tolerance", json_real(tolerance));
+    json_object_set_new(root, "hysteresis", json_real(hysteresis));
+    json_object_set_new(root, "antiAliasing", json_integer(antiAliasing));
+    json_object_set_new(root, "polyphony", json_integer(polyphony));
     return root;
   }
 
   void dataFromJson(json_t *root) override {
+    // Tolerance used to be set from the menu and saved here
     json_t *toleranceJ = json_object_get(root, "tolerance");
     if (toleranceJ) {
-      tolerance = json_number_value(toleranceJ);
+      params[TOLERANCE_PARAM].setValue(json_number_value(toleranceJ));
+    }
+    json_t *hysteresisJ = json_object_get(root, "hysteresis");
+    if (hysteresisJ) {
+      hysteresis = json_number_value(hysteresisJ);
+    }
+    json_t *antiAliasingJ = json_object_get(root, "antiAliasing");
+    if (antiAliasingJ) {
+      antiAliasing = json_integer_value(antiAliasingJ);
     }
+    json_t *polyphonyJ = json_object_get(root, "polyphony");
+    if (polyphonyJ) {
+      polyphony = json_integer_value(polyphonyJ);
+    }
+    toleranceChannels = 0;
+    primedChannels = 0;
+  }
+
+  void route(int aChannels, int bChannels) {
+    switch (polyphony) {
+      case POLYPHONY_MIN:
+        channels = std::min(aChannels, bChannels);
+        break;
+      case POLYPHONY_A:
+        channels = aChannels;
+        break;
+      case POLYPHONY_B:
+        channels = bChannels;
+        break;
+      default:
+        channels = std::max(aChannels, bChannels);
+    }
+    aRouting.resolve(aChannels, channels, polyphony == POLYPHONY_CYCLE);
+    bRouting.resolve(bChannels, channels, polyphony == POLYPHONY_CYCLE);
+    routedA = aChannels;
+    routedB = bChannels;
+    routedPolyphony = polyphony;
   }
 
   void process(const ProcessArgs &args) override {
-    int channels = inputs[A_INPUT].getChannels();
+    bool aConnected = inputs[A_INPUT].isConnected();
+    int bChannels = inputs[B_INPUT].getChannels();
+    // The A knob counts as a mono input once B is patched
+    int aChannels = aConnected ? inputs[A_INPUT].getChannels() : std::min(bChannels, 1);
 
-    if (inputs[B_INPUT].getChannels() > channels) {
-      channels = inputs[B_INPUT].getChannels();
+    if (aChannels != routedA || bChannels != routedB || polyphony != routedPolyphony) {
+      route(aChannels, bChannels);
     }
 
     outputs[LESS_OUTPUT].setChannels(channels);
     outputs[EQUAL_OUTPUT].setChannels(channels);
     outputs[GREATER_OUTPUT].setChannels(channels);
+    outputs[RISE_OUTPUT].setChannels(channels);
+    outputs[FALL_OUTPUT].setChannels(channels);
+    outputs[OFFSET_OUTPUT].setChannels(channels);
+    // Rack keeps one channel on a connected output, which would hold its last voltage
+    if (channels == 0) {
+      outputs[LESS_OUTPUT].setVoltage(0.f);
+      outputs[EQUAL_OUTPUT].setVoltage(0.f);
+      outputs[GREATER_OUTPUT].setVoltage(0.f);
+      outputs[RISE_OUTPUT].setVoltage(0.f);
+      outputs[FALL_OUTPUT].setVoltage(0.f);
+      outputs[OFFSET_OUTPUT].setVoltage(0.f);
+    }
 
-    float a = params[A_PARAM].getValue();
-    bool aConnected = inputs[A_INPUT].isConnected();
-    bool aMono = inputs[A_INPUT].isMonophonic();
-    bool bMono = inputs[B_INPUT].isMonophonic();
+    float aParam = params[A_PARAM].getValue();
+    const float *aVoltages = aConnected ? inputs[A_INPUT].getVoltages() : &aParam;
+    const float *bVoltages = inputs[B_INPUT].getVoltages();
+    int oversample = antiAliasing >= ANTI_ALIASING_2X ? 2 << (antiAliasing - ANTI_ALIASING_2X) : 1;
+    int crossingDelay = std::round(halfBandLatency(oversample));
+    crossingPos = (crossingPos + 1) % CROSSING_HISTORY;
+    int delayedPos = (crossingPos - crossingDelay + CROSSING_HISTORY) % CROSSING_HISTORY;
+
+    bool smooth = toleranceDivider.process();
+    if (smooth || channels > toleranceChannels) {
+      float deltaTime = args.sampleTime * toleranceDivider.getDivision();
+      float toleranceParam = params[TOLERANCE_PARAM].getValue();
+      for (int c = 0; c < channels; c += 4) {
+        simd::float_4 tolerance = simd::clamp(toleranceParam + inputs[TOLERANCE_INPUT].getPolyVoltageSimd<simd::float_4>(c) / 10.f, 0.f, 1.f);
+        // Rising from 0V would briefly read as A not equal to B
+        simd::float_4 unsmoothed = simd::float_4(c, c + 1, c + 2, c + 3) >= (float)toleranceChannels;
+        toleranceFilter[c / 4].out = simd::ifelse(unsmoothed, tolerance, toleranceFilter[c / 4].out);
+        if (smooth) {
+          toleranceFilter[c / 4].process(deltaTime, tolerance);
+        }
+      }
+    }
+    // Channels that were dropped start again at their tolerance if they come back
+    toleranceChannels = channels;
+
+    for (int c = 0; c < channels; c += 4) {
+      // An output switches on once A - B passes its threshold plus the hysteresis, and holds
+      // until it falls back within the threshold minus the hysteresis
+      simd::float_4 onThreshold = toleranceFilter[c / 4].out + hysteresis;
+      simd::float_4 offThreshold = toleranceFilter[c / 4].out - hysteresis;
+
+      simd::float_4 d = aRouting.load(aVoltages, c) - bRouting.load(bVoltages, c);
+
+      bool priming = c + 4 > primedChannels;
+      simd::float_4 primed = simd::float_4::mask();
+      if (priming) {
+        primed = simd::float_4(c, c + 1, c + 2, c + 3) < (float)primedChannels;
+        greater[c / 4] &= primed;
+        less[c / 4] &= primed;
+      }
 
-    for (int c = 0; c < channels; c++) {
-      outputs[LESS_OUTPUT].setVoltage(0.0f, c);
-      outputs[EQUAL_OUTPUT].setVoltage(0.0f, c);
-      outputs[GREATER_OUTPUT].setVoltage(0.0f, c);
+      simd::float_4 isGreater = (d > onThreshold) | (greater[c / 4] & (d > offThreshold));
+      simd::float_4 isLess = (d < -onThreshold) | (less[c / 4] & (d < -offThreshold));
+
+      if (priming) {
+        greater[c / 4] = simd::ifelse(primed, greater[c / 4], isGreater);
+        less[c / 4] = simd::ifelse(primed, less[c / 4], isLess);
+        oversampledGreater[c / 4] = simd::ifelse(primed, oversampledGreater[c / 4], isGreater);
+        oversampledLess[c / 4] = simd::ifelse(primed, oversampledLess[c / 4], isLess);
+        dPrev[c / 4] = simd::ifelse(primed, dPrev[c / 4], d);
+        // Nor have they any crossings waiting to come out
+        for (int j = 0; j < CROSSING_HISTORY; j++) {
+          for (int k = 0; k < 3; k++) {
+            crossingHistory[j][k][c / 4] &= primed;
+          }
+        }
+      }
+      simd::float_4 lessOut, equalOut, greaterOut;
+
+      if (oversample > 1) {
+        dUpsampler[c / 4].setFactor(oversample);
+        greaterDownsampler[c / 4].setFactor(oversample);
+        lessDownsampler[c / 4].setFactor(oversample);
+
+        // Upsampling is linear, so A - B is upsampled once rather than A and B separately
+        simd::float_4 dUp[HalfBandUpsampler<simd::float_4>::MAX_FACTOR];
+        simd::float_4 greaterUp[HalfBandUpsampler<simd::float_4>::MAX_FACTOR];
+        simd::float_4 lessUp[HalfBandUpsampler<simd::float_4>::MAX_FACTOR];
+        dUpsampler[c / 4].process(d, dUp);
+
+        for (int i = 0; i < oversample; i++) {
+          oversampledGreater[c / 4] = (dUp[i] > onThreshold) | (oversampledGreater[c / 4] & (dUp[i] > offThreshold));
+          oversampledLess[c / 4] = (dUp[i] < -onThreshold) | (oversampledLess[c / 4] & (dUp[i] < -offThreshold));
+          greaterUp[i] = simd::ifelse(oversampledGreater[c / 4], 10.0f, 0.0f);
+          lessUp[i] = simd::ifelse(oversampledLess[c / 4], 10.0f, 0.0f);
+        }
+
+        greaterOut = greaterDownsampler[c / 4].process(greaterUp);
+        lessOut = lessDownsampler[c / 4].process(lessUp);
+        // The three gates always add up to 10V, so the filtered equal gate follows from the other two
+        equalOut = 10.0f - greaterOut - lessOut;
+      } else {
+        lessOut = simd::ifelse(isLess, 10.0f, 0.0f);
+        equalOut = simd::ifelse(isGreater | isLess, 0.0f, 10.0f);
+        greaterOut = simd::ifelse(isGreater, 10.0f, 0.0f);
+
+        if (antiAliasing == ANTI_ALIASING_MINBLEP) {
+          int greaterEdges = simd::movemask(isGreater ^ greater[c / 4]);
+          if (greaterEdges) {
+            simd::float_4 step = simd::ifelse(isGreater, 10.0f, -10.0f);
+            simd::float_4 t = crossing(dPrev[c / 4], d, simd::ifelse(isGreater, onThreshold, offThreshold));
+            insertSteps(blep[GREATER_OUTPUT][c / 4], greaterEdges, t, step);
+            insertSteps(blep[EQUAL_OUTPUT][c / 4], greaterEdges, t, -step);
+          }
+          int lessEdges = simd::movemask(isLess ^ less[c / 4]);
+          if (lessEdges) {
+            simd::float_4 step = simd::ifelse(isLess, 10.0f, -10.0f);
+            simd::float_4 t = crossing(dPrev[c / 4], d, simd::ifelse(isLess, -onThreshold, -offThreshold));
+            insertSteps(blep[LESS_OUTPUT][c / 4], lessEdges, t, step);
+            insertSteps(blep[EQUAL_OUTPUT][c / 4], lessEdges, t, -step);
+          }
+          lessOut += blep[LESS_OUTPUT][c / 4].process();
+          equalOut += blep[EQUAL_OUTPUT][c / 4].process();
+          greaterOut += blep[GREATER_OUTPUT][c / 4].process();
+        }
+      }
 
-      if (aConnected) {
-        a = inputs[A_INPUT].getVoltage(aMono ? 0 : c);
+      // A crossing into greater or less starts a trigger and sets the offset of the crossing
+      simd::float_4 rise = isGreater & ~greater[c / 4];
+      simd::float_4 fall = isLess & ~less[c / 4];
+      if (simd::movemask(rise | fall)) {
+        simd::float_4 t = crossing(dPrev[c / 4], d, simd::ifelse(rise, onThreshold, -onThreshold));
+        offset[c / 4] = simd::ifelse(rise | fall, (1.f - t) * 10.f, offset[c / 4]);
+        riseTime[c / 4] = simd::ifelse(rise, 1e-3f, riseTime[c / 4]);
+        fallTime[c / 4] = simd::ifelse(fall, 1e-3f, fallTime[c / 4]);
       }
+      riseTime[c / 4] -= args.sampleTime;
+      fallTime[c / 4] -= args.sampleTime;
+
+      greater[c / 4] = isGreater;
+      less[c / 4] = isLess;
+      dPrev[c / 4] = d;
+
+      crossingHistory[crossingPos][0][c / 4] = simd::ifelse(riseTime[c / 4] > 0.f, 10.0f, 0.0f);
+      crossingHistory[crossingPos][1][c / 4] = simd::ifelse(fallTime[c / 4] > 0.f, 10.0f, 0.0f);
+      crossingHistory[crossingPos][2][c / 4] = offset[c / 4];
+      outputs[RISE_OUTPUT].setVoltageSimd(crossingHistory[delayedPos][0][c / 4], c);
+      outputs[FALL_OUTPUT].setVoltageSimd(crossingHistory[delayedPos][1][c / 4], c);
+      outputs[OFFSET_OUTPUT].setVoltageSimd(crossingHistory[delayedPos][2][c / 4], c);
+
+      outputs[LESS_OUTPUT].setVoltageSimd(lessOut, c);
+      outputs[EQUAL_OUTPUT].setVoltageSimd(equalOut, c);
+      outputs[GREATER_OUTPUT].setVoltageSimd(greaterOut, c);
+    }
+    // Channels that were dropped are primed again if they come back
+    primedChannels = channels;
+
+    if (outputs[ZONE_OUTPUT].isConnected() || outputs[ZONES_OUTPUT].isConnected()) {
+      processZones(aConnected, aParam);
+    }
+  }
 
-      float b = inputs[B_INPUT].getVoltage(bMono ? 0 : c);
+  // Fraction of the way from the previous sample to this one at which A - B reached the threshold,
+  // assuming it changed linearly in between
+  static simd::float_4 crossing(simd::float_4 dPrev, simd::float_4 d, simd::float_4 threshold) {
+    simd::float_4 t = (threshold - dPrev) / (d - dPrev);
+    // A moving threshold can switch an output while A - B stays still
+    return simd::ifelse(d == dPrev, 1.f, simd::clamp(t, 0.f, 1.f));
+  }
 
-      if (a < b - tolerance) {
-        outputs[LESS_OUTPUT].setVoltage(10.0f, c);
-      } else if (a > b + tolerance) {
-        outputs[GREATER_OUTPUT].setVoltage(10.0f, c);
-      } else {
-        outputs[EQUAL_OUTPUT].setVoltage(10.0f, c);
+  static void insertSteps(dsp::MinBlepGenerator<16, 16, simd::float_4> &blep, int lanes, simd::float_4 t, simd::float_4 step) {
+    for (int i = 0; i < 4; i++) {
+      if (lanes & (1 << i)) {
+        blep.insertDiscontinuity(t[i] - 1.f, simd::movemaskInverse<simd::float_4>(1 << i) & step);
       }
     }
   }
+
+  // Each channel of B is a threshold, and A is placed in the zones between them
+  void processZones(bool aConnected, float aParam) {
+    // The zone gates need one more channel than there are thresholds, so a 16th channel of B is ignored
+    int thresholds = std::min(inputs[B_INPUT].getChannels(), 15);
+    int channels = aConnected ? inputs[A_INPUT].getChannels() : 1;
+    float knob[16];
+    std::fill(knob, knob + 16, aParam);
+    float zones[16];
+    int active = findZones(aConnected ? inputs[A_INPUT].getVoltages() : knob, channels, inputs[B_INPUT].getVoltages(), thresholds, zones);
+
+    outputs[ZONE_OUTPUT].setChannels(channels);
+    for (int c = 0; c < channels; c++) {
+      outputs[ZONE_OUTPUT].setVoltage(zones[c], c);
+    }
+
+    // One gate per zone, high while any channel of A is in it
+    outputs[ZONES_OUTPUT].setChannels(thresholds + 1);
+    for (int zone = 0; zone <= thresholds; zone++) {
+      outputs[ZONES_OUTPUT].setVoltage(active & (1 << zone) ? 10.0f : 0.0f, zone);
+    }
+  }
 };
 
-struct ToleranceQuantity : Quantity {
-  float *srcTolerance = NULL;
+struct HysteresisQuantity : Quantity {
+  float *srcHysteresis = NULL;
 
-  ToleranceQuantity(float *_srcTolerance) {
-    srcTolerance = _srcTolerance;
+  HysteresisQuantity(float *_srcHysteresis) {
+    srcHysteresis = _srcHysteresis;
   }
 
   void setValue(float value) override {
-    *srcTolerance = math::clamp(value, getMinValue(), getMaxValue());
+    *srcHysteresis = math::clamp(value, getMinValue(), getMaxValue());
   }
 
   float getValue() override {
-    return *srcTolerance;
+    return *srcHysteresis;
   }
 
   float getMinValue() override {
@@ -121,12 +465,12 @@ struct ToleranceQuantity : Quantity {
   }
 };
 
-struct ToleranceSlider : ui::Slider {
-  ToleranceSlider(float *_srcTolerance) {
-    quantity = new ToleranceQuantity(_srcTolerance);
+struct HysteresisSlider : ui::Slider {
+  HysteresisSlider(float *_srcHysteresis) {
+    quantity = new HysteresisQuantity(_srcHysteresis);
   }
 
-  ~ToleranceSlider() {
+  ~HysteresisSlider() {
     delete quantity;
   }
 };
@@ -142,13 +486,20 @@ struct ComparatorWidget : ModuleWidget {
     addChild(createWidget<LilacScrew>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
     addParam(createParamCentered<LilacKnob>(mm2px(Vec(7.62, 23.284)), module, Comparator::A_PARAM));
+    addParam(createParamCentered<LilacKnob>(mm2px(Vec(22.86, 23.284)), module, Comparator::TOLERANCE_PARAM));
 
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 36.463)), module, Comparator::A_INPUT));
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 55.048)), module, Comparator::B_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 36.463)), module, Comparator::TOLERANCE_INPUT));
 
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 75.534)), module, Comparator::LESS_OUTPUT));
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 93.947)), module, Comparator::EQUAL_OUTPUT));
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 112.359)), module, Comparator::GREATER_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(22.86, 93.947)), module, Comparator::ZONE_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(22.86, 112.359)), module, Comparator::ZONES_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(38.1, 75.534)), module, Comparator::RISE_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(38.1, 93.947)), module, Comparator::FALL_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(38.1, 112.359)), module, Comparator::OFFSET_OUTPUT));
   }
 
   void appendContextMenu(Menu *menu) override {
@@ -156,13 +507,31 @@ struct ComparatorWidget : ModuleWidget {
 
     menu->addChild(new MenuSeparator());
 
-    MenuLabel *toleranceLabel = new MenuLabel();
-    toleranceLabel->text = "A = B tolerance";
-    menu->addChild(toleranceLabel);
-
-    ToleranceSlider *toleranceSlider = new ToleranceSlider(&module->tolerance);
-    toleranceSlider->box.size.x = 180.0f;
-    menu->addChild(toleranceSlider);
+    MenuLabel *hysteresisLabel = new MenuLabel();
+    hysteresisLabel->text = "Hysteresis";
+    menu->addChild(hysteresisLabel);
+
+    HysteresisSlider *hysteresisSlider = new HysteresisSlider(&module->hysteresis);
+    hysteresisSlider->box.size.x = 180.0f;
+    menu->addChild(hysteresisSlider);
+
+    menu->addChild(createIndexSubmenuItem(
+        "Anti-aliasing", {"Off", "minBLEP", "2x oversampling", "4x oversampling", "8x oversampling"},
+        [=]() {
+          return module->antiAliasing;
+        },
+        [=](int value) {
+          module->antiAliasing = value;
+        }));
+
+    menu->addChild(createIndexSubmenuItem(
+        "Polyphony", {"Most channels of A or B", "Fewest channels of A or B", "Channels of A", "Channels of B", "Most channels, repeating the shorter input"},
+        [=]() {
+          return module->polyphony;
+        },
+        [=](int value) {
+          module->polyphony = value;
+        }));
   }
 };
 
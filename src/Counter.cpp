@@ -1,26 +1,45 @@
 #include "plugin.hpp"
 #include "./controls.hpp"
+#include "./clock.hpp"
+#include "./xoshiro.hpp"
+
+// Divisions used when the divisions input is not patched
+static const std::vector<std::vector<int>> DIVISION_PRESETS = {
+    {2, 4, 8, 16},
+    {2, 3, 4, 8},
+    {2, 3, 4, 5, 6, 7, 8},
+    {2, 4, 8, 16, 32, 64},
+};
+
+static const std::vector<int> MULTIPLIERS = {2, 3, 4, 6, 8, 16};
 
 struct Counter : Module {
   enum ParamId {
     COUNT_PARAM,
+    PROBABILITY_PARAM,
+    SWING_PARAM,
     PARAMS_LEN
   };
   enum InputId {
     CLOCK_INPUT,
     RESET_INPUT,
+    COUNT_INPUT,
+    DIVISIONS_INPUT,
     INPUTS_LEN
   };
   enum OutputId {
     GATE_OUTPUT,
     END_OF_CYCLE_OUTPUT,
+    DIVISIONS_OUTPUT,
+    POSITION_OUTPUT,
+    PHASE_OUTPUT,
+    MULTIPLY_OUTPUT,
     OUTPUTS_LEN
   };
   enum LightId {
     LIGHTS_LEN
   };
 
-  dsp::ClockDivider uiDivider;
   dsp::BooleanTrigger clockTrig;
   dsp::BooleanTrigger resetTrig;
   dsp::PulseGenerator endOfCycle;
@@ -29,32 +48,158 @@ struct Counter : Module {
   int limit = 0;
   int count = 0;
   bool autoReset = false;
+  ClockPeriod clockPeriod;
+  ClockMultiplier clockMultiplier;
+  dsp::PulseGenerator multiplyPulse;
+
+  // Counted pulses are kept at random with the probability, from a generator that restarts
+  // from the saved seed on reset. Every other pulse is held back by the swing.
+  Xoshiro128 rng;
+  uint32_t seed = 0;
+  bool offbeat = false;
+  uint32_t swingDelay = 0;
+  // Samples since the last counted pulse, which the phase ramps from
+  uint32_t sinceCount = 0;
+
+  // Clock divider bank, counting the same clock edges in every lane
+  int divisionPreset = 0;
+  int divisionChannels = 0;
+  simd::float_4 divisionCount[4];
+  simd::float_4 divisionLimit[4];
 
   Counter() {
     config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
     configParam(COUNT_PARAM, 1.f, 128.f, 5.f, "Count");
+    configParam(PROBABILITY_PARAM, 0.f, 1.f, 1.f, "Probability of counting each clock pulse", "%", 0.f, 100.f);
+    configParam(SWING_PARAM, 0.f, 0.5f, 0.f, "Swing delay of every other clock pulse", "% of a period", 0.f, 100.f);
     configInput(CLOCK_INPUT, "Clock");
     configInput(RESET_INPUT, "Reset");
+    configInput(COUNT_INPUT, "Count CV (1V per count)");
+    configInput(DIVISIONS_INPUT, "Clock divisions (1V per division)");
     configOutput(GATE_OUTPUT, "Gate");
     configOutput(END_OF_CYCLE_OUTPUT, "End of cycle");
+    configOutput(DIVISIONS_OUTPUT, "Divided clocks");
+    configOutput(POSITION_OUTPUT, "Position in cycle");
+    configOutput(PHASE_OUTPUT, "Phase in cycle, smoothed between clock pulses");
+    configOutput(MULTIPLY_OUTPUT, "Multiplied clock");
     paramQuantities[COUNT_PARAM]->snapEnabled = true;
-    uiDivider.setDivision(1024);
+
+    for (int i = 0; i < 4; i++) {
+      divisionLimit[i] = 1.f;
+    }
+    restartDivisions();
+    clockMultiplier.factor = MULTIPLIERS[0];
+    seed = random::u32();
+    rng.seed(seed);
+  }
+
+  json_t *dataToJson() override {
+    json_t *rootJ = json_object();
+    json_object_set_new(rootJ, "divisionPreset", json_integer(divisionPreset));
+    json_object_set_new(rootJ, "multiplier", json_integer(clockMultiplier.factor));
+    json_object_set_new(rootJ, "seed", json_integer(seed));
+    return rootJ;
+  }
+
+  void dataFromJson(json_t *rootJ) override {
+    json_t *divisionPresetJ = json_object_get(rootJ, "divisionPreset");
+    if (divisionPresetJ) {
+      divisionPreset = clamp((int)json_integer_value(divisionPresetJ), 0, (int)DIVISION_PRESETS.size() - 1);
+    }
+    json_t *multiplierJ = json_object_get(rootJ, "multiplier");
+    if (multiplierJ) {
+      clockMultiplier.factor = clamp((int)json_integer_value(multiplierJ), 1, 16);
+    }
+    json_t *seedJ = json_object_get(rootJ, "seed");
+    if (seedJ) {
+      seed = json_integer_value(seedJ);
+      rng.seed(seed);
+    }
+    restartDivisions();
+  }
+
+  // The limit only matters when a clock arrives, so it is read then, and never late
+  int getLimit() {
+    float limit = getParam(COUNT_PARAM).getValue() + getInput(COUNT_INPUT).getVoltage();
+    return clamp(static_cast<int>(std::round(limit)), 1, 128);
+  }
+
+  // Divisions are only read on clock edges, like the count
+  void updateDivisions() {
+    Input &divisions = getInput(DIVISIONS_INPUT);
+    if (divisions.isConnected()) {
+      divisionChannels = divisions.getChannels();
+      for (int c = 0; c < divisionChannels; c += 4) {
+        divisionLimit[c / 4] = simd::fmax(simd::round(divisions.getVoltageSimd<simd::float_4>(c)), 1.f);
+      }
+    } else {
+      const std::vector<int> &preset = DIVISION_PRESETS[divisionPreset];
+      divisionChannels = preset.size();
+      for (int c = 0; c < divisionChannels; c++) {
+        divisionLimit[c / 4][c % 4] = preset[c];
+      }
+    }
+  }
+
+  // Each divider waits on the last count of its cycle, so the next clock edge starts a cycle
+  void restartDivisions() {
+    updateDivisions();
+    for (int i = 0; i < 4; i++) {
+      divisionCount[i] = divisionLimit[i] - 1.f;
+    }
   }
 
   void process(const ProcessArgs &args) override {
-    if (uiDivider.process()) {
-      limit = static_cast<float>(getParam(COUNT_PARAM).getValue());
+    bool reset = resetTrig.process(getInput(RESET_INPUT).getVoltage() > 0.f);
+    bool clockHigh = getInput(CLOCK_INPUT).getVoltageSum() > 0.f;
+    bool clock = clockTrig.process(clockHigh);
+    clockPeriod.process(clock);
+    if (clockMultiplier.process(clock, clockPeriod)) {
+      multiplyPulse.trigger();
     }
 
-    if (resetTrig.process(getInput(RESET_INPUT).getVoltage() > 0.f)) {
+    if (reset) {
       count = 0;
       gate = 0.f;
       init = true;
+      restartDivisions();
+      rng.seed(seed);
+      offbeat = false;
+      swingDelay = 0;
+      sinceCount = 0;
+    }
+
+    // The dividers count every edge, patched or not, so they stay in step with the clock when the
+    // divisions output is connected later
+    if (clock) {
+      updateDivisions();
+      for (int c = 0; c < divisionChannels; c += 4) {
+        simd::float_4 next = divisionCount[c / 4] + 1.f;
+        divisionCount[c / 4] = simd::ifelse(next >= divisionLimit[c / 4], 0.f, next);
+      }
+    }
+
+    // Swing delays every other pulse by a number of samples, measured from the clock period
+    bool step = false;
+    if (swingDelay > 0 && --swingDelay == 0) {
+      step = true;
+    }
+    if (clock) {
+      uint32_t delay = offbeat ? getParam(SWING_PARAM).getValue() * clockPeriod.period : 0;
+      if (delay > 0) {
+        swingDelay = delay;
+      } else {
+        step = true;
+      }
+      offbeat = !offbeat;
     }
 
-    if (init && clockTrig.process(getInput(CLOCK_INPUT).getVoltageSum() > 0.f)) {
+    sinceCount++;
+    if (init && step && rng.uniform() < getParam(PROBABILITY_PARAM).getValue()) {
+      sinceCount = 0;
       gate = 10.f;
       count = count + 1;
+      limit = getLimit();
       if (count >= limit) {
         count = 0;
         gate = 0.f;
@@ -65,6 +210,25 @@ struct Counter : Module {
 
     getOutput(GATE_OUTPUT).setVoltage(gate);
     getOutput(END_OF_CYCLE_OUTPUT).setVoltage(endOfCycle.process(args.sampleTime) * 10.f);
+    getOutput(MULTIPLY_OUTPUT).setVoltage(multiplyPulse.process(args.sampleTime) * 10.f);
+
+    if (limit > 0) {
+      getOutput(POSITION_OUTPUT).setVoltage(10.f * count / limit);
+      // Continue from the current count towards the next one at the measured clock rate, from the
+      // pulse that was counted rather than the clock, which swing and probability can move away from
+      if (getOutput(PHASE_OUTPUT).isConnected()) {
+        float phase = init ? count + clockPeriod.phase(sinceCount) : 0.f;
+        getOutput(PHASE_OUTPUT).setVoltage(10.f * phase / limit);
+      }
+    }
+
+    // Each divided clock is high for the first half of its cycle, and /1 passes the clock through
+    getOutput(DIVISIONS_OUTPUT).setChannels(divisionChannels);
+    simd::float_4 clockGate = clockHigh ? simd::float_4::mask() : simd::float_4::zero();
+    for (int c = 0; c < divisionChannels; c += 4) {
+      simd::float_4 high = simd::ifelse(divisionLimit[c / 4] == 1.f, clockGate, divisionCount[c / 4] < divisionLimit[c / 4] * 0.5f);
+      getOutput(DIVISIONS_OUTPUT).setVoltageSimd(simd::ifelse(high, 10.f, 0.f), c);
+    }
   }
 };
 
@@ -79,18 +243,49 @@ struct CounterWidget : ModuleWidget {
     addChild(createWidget<LilacScrew>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
     addParam(createParamCentered<LilacKnob>(mm2px(Vec(7.62, 28.047)), module, Counter::COUNT_PARAM));
+    addParam(createParamCentered<LilacKnob>(mm2px(Vec(38.1, 28.047)), module, Counter::PROBABILITY_PARAM));
+    addParam(createParamCentered<LilacKnob>(mm2px(Vec(38.1, 47.669)), module, Counter::SWING_PARAM));
 
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 47.669)), module, Counter::CLOCK_INPUT));
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 65.661)), module, Counter::RESET_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 28.047)), module, Counter::COUNT_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 47.669)), module, Counter::DIVISIONS_INPUT));
 
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 94.897)), module, Counter::GATE_OUTPUT));
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 112.209)), module, Counter::END_OF_CYCLE_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(22.86, 94.897)), module, Counter::DIVISIONS_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(22.86, 112.209)), module, Counter::MULTIPLY_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(38.1, 94.897)), module, Counter::POSITION_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(38.1, 112.209)), module, Counter::PHASE_OUTPUT));
   }
 
   void appendContextMenu(Menu *menu) override {
     Counter *module = getModule<Counter>();
     menu->addChild(new MenuSeparator);
     menu->addChild(createBoolPtrMenuItem("Reset automatically", "", &module->autoReset));
+
+    std::vector<std::string> presetLabels;
+    for (const std::vector<int> &preset : DIVISION_PRESETS) {
+      std::string label;
+      for (int division : preset) {
+        label += (label.empty() ? "/" : ", /") + std::to_string(division);
+      }
+      presetLabels.push_back(label);
+    }
+    menu->addChild(createIndexPtrSubmenuItem("Divisions", presetLabels, &module->divisionPreset));
+
+    std::vector<std::string> multiplierLabels;
+    for (int multiplier : MULTIPLIERS) {
+      multiplierLabels.push_back("x" + std::to_string(multiplier));
+    }
+    menu->addChild(createIndexSubmenuItem(
+        "Clock multiplier", multiplierLabels,
+        [=]() {
+          return std::find(MULTIPLIERS.begin(), MULTIPLIERS.end(), module->clockMultiplier.factor) - MULTIPLIERS.begin();
+        },
+        [=](int index) {
+          module->clockMultiplier.factor = MULTIPLIERS[index];
+        }));
   }
 };
 
@@ -0,0 +1,89 @@
+#include "plugin.hpp"
+#include "./controls.hpp"
+#include "./sorting.hpp"
+
+struct Sort : Module {
+  enum ParamId {
+    PARAMS_LEN
+  };
+  enum InputId {
+    IN_INPUT,
+    INPUTS_LEN
+  };
+  enum OutputId {
+    SORTED_OUTPUT,
+    RANK_OUTPUT,
+    MIN_OUTPUT,
+    MEDIAN_OUTPUT,
+    MAX_OUTPUT,
+    OUTPUTS_LEN
+  };
+  enum LightId {
+    LIGHTS_LEN
+  };
+
+  Sort() {
+    config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+    configInput(IN_INPUT, "Polyphonic");
+    configOutput(SORTED_OUTPUT, "Sorted ascending");
+    configOutput(RANK_OUTPUT, "Rank of each input channel (1V per rank)");
+    configOutput(MIN_OUTPUT, "Minimum");
+    configOutput(MEDIAN_OUTPUT, "Median");
+    configOutput(MAX_OUTPUT, "Maximum");
+    configBypass(IN_INPUT, SORTED_OUTPUT);
+  }
+
+  void process(const ProcessArgs &args) override {
+    int channels = inputs[IN_INPUT].getChannels();
+    float sorted[16];
+    float order[16];
+
+    // Unused channels sort to the end
+    for (int c = 0; c < 16; c += 4) {
+      simd::float_4 channel = simd::float_4(c, c + 1, c + 2, c + 3);
+      simd::ifelse(channel < channels, inputs[IN_INPUT].getVoltageSimd<simd::float_4>(c), INFINITY).store(&sorted[c]);
+      channel.store(&order[c]);
+    }
+
+    sort16(sorted, order);
+
+    outputs[SORTED_OUTPUT].setChannels(channels);
+    outputs[RANK_OUTPUT].setChannels(channels);
+    for (int c = 0; c < channels; c++) {
+      outputs[SORTED_OUTPUT].setVoltage(sorted[c], c);
+      outputs[RANK_OUTPUT].setVoltage(c, (int)order[c]);
+    }
+
+    if (channels > 0) {
+      outputs[MIN_OUTPUT].setVoltage(sorted[0]);
+      outputs[MAX_OUTPUT].setVoltage(sorted[channels - 1]);
+      outputs[MEDIAN_OUTPUT].setVoltage((sorted[(channels - 1) / 2] + sorted[channels / 2]) / 2.f);
+    } else {
+      outputs[MIN_OUTPUT].setVoltage(0.f);
+      outputs[MAX_OUTPUT].setVoltage(0.f);
+      outputs[MEDIAN_OUTPUT].setVoltage(0.f);
+    }
+  }
+};
+
+struct SortWidget : ModuleWidget {
+  SortWidget(Sort *module) {
+    setModule(module);
+    setPanel(createPanel(asset::plugin(pluginInstance, "res/Sort.svg")));
+
+    addChild(createWidget<LilacScrew>(Vec(RACK_GRID_WIDTH, 0)));
+    addChild(createWidget<LilacScrew>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
+    addChild(createWidget<LilacScrew>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+    addChild(createWidget<LilacScrew>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 20.929)), module, Sort::IN_INPUT));
+
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 39.429)), module, Sort::SORTED_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 56.857)), module, Sort::RANK_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 75.534)), module, Sort::MIN_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 93.947)), module, Sort::MEDIAN_OUTPUT));
+    addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 112.359)), module, Sort::MAX_OUTPUT));
+  }
+};
+
+Model *modelSort = createModel<Sort, SortWidget>("Sort");
@@ -1,5 +1,12 @@
 #include "plugin.hpp"
 #include "./controls.hpp"
+#include "./xoshiro.hpp"
+#include "./distribution.hpp"
+#include "./burst.hpp"
+
+// Shortest time between the triggers of a voice in continuous mode, twice the length of a
+// trigger, so they never run together into a gate
+static const float MIN_INTERVAL = 2e-3f;
 
 struct Spray : Module {
   enum ParamId {
@@ -11,6 +18,7 @@ struct Spray : Module {
   enum InputId {
     TRIGGER_INPUT,
     DELAY_TIME_INPUT,
+    SEED_INPUT,
     INPUTS_LEN
   };
   enum OutputId {
@@ -21,50 +29,211 @@ struct Spray : Module {
     LIGHTS_LEN
   };
 
+  enum Mode {
+    MODE_BURST,
+    MODE_BURST_PER_CHANNEL,
+    MODE_CONTINUOUS
+  };
+
   dsp::BooleanTrigger inputTrig;
-  dsp::Timer timer;
+  dsp::TSchmittTrigger<simd::float_4> channelTrig[4];
+  dsp::BooleanTrigger seedTrig;
   dsp::PulseGenerator trigs[16];
   dsp::ClockDivider uiDivider;
-  bool armed[16];
-  float delay[16];
+  int mode = MODE_BURST;
+  int voices = 4;
   int channels = 4;
 
+  // One entry per output channel, counting down the samples until the voice triggers, or -1 once
+  // it has. Each trigger channel can start its own burst in MODE_BURST_PER_CHANNEL, and the voices
+  // of every burst are given output channels by takeVoice().
+  int32_t countdown[16];
+  int nextVoice = 0;
+
+  // In MODE_CONTINUOUS each voice is a Poisson process, and draws the samples to its next trigger
+  // as soon as it fires. The intervals come from a table with a mean of 1, four at a time. The mean
+  // is read with the other controls, and a new one rescales the countdowns already drawn, which is
+  // fair since exponential intervals have no memory.
+  DistributionTable intervalTable;
+  float intervals[4];
+  int intervalsLeft = 0;
+  bool continuous = false;
+  float meanInterval = 0.f;
+  int32_t minInterval = 0;
+
+  // Delays are drawn from the module's own generator, four voices at a time. A trigger at the seed
+  // input restarts it from the saved seed, so the same bursts play back on every render.
+  Xoshiro128x4 rng;
+  uint32_t seed = 0;
+
+  // Raising the delays to the power of the bias crowds them towards the start of the burst, and
+  // one of the precomputed distributions then spreads them over it. The two curves are composed
+  // into one table, rebuilt with the other controls when the knob or the distribution changes,
+  // so a burst takes one lookup per four voices and choosing a distribution never allocates.
+  DistributionTable burstTable;
+  float bias = 1.f;
+  int tableDistribution = DISTRIBUTION_UNIFORM;
+  const DistributionTable *distributions = distributionTables();
+  int distribution = DISTRIBUTION_UNIFORM;
+
   Spray() {
     config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
     configParam(DELAY_TIME_PARAM, 0.f, 1.f, 0.f, "Max time", " s");
     configParam(VOICES_PARAM, 1.f, 16.f, 4.f, "Voices");
-    configParam(BIAS_PARAM, 1.f, 32.f, 1.f, "Bias");
+    configParam(BIAS_PARAM, 1.f, 32.f, 1.f, "Bias towards short delays");
     configInput(TRIGGER_INPUT, "Trigger");
     configInput(DELAY_TIME_INPUT, "Time attenuator");
+    configInput(SEED_INPUT, "Restart random sequence from seed");
     configOutput(TRIGGER_OUTPUT, "Poly trigger");
     paramQuantities[VOICES_PARAM]->snapEnabled = true;
     uiDivider.setDivision(1024);
+    burstTable.fillPower(bias);
+    reseed(random::u32());
+    intervalTable.fill(distribution::interval);
+  }
+
+  void reseed(uint32_t seed) {
+    this->seed = seed;
+    restart();
+  }
+
+  // Start the random sequence again from the seed, and drop the triggers already drawn from it,
+  // so the same triggers follow every restart
+  void restart() {
+    rng.seed(seed);
+    for (int i = 0; i < 16; i++) {
+      countdown[i] = -1;
+    }
+    nextVoice = 0;
+    intervalsLeft = 0;
+  }
+
+  json_t *dataToJson() override {
+    json_t *rootJ = json_object();
+    json_object_set_new(rootJ, "seed", json_integer(seed));
+    json_object_set_new(rootJ, "distribution", json_integer(distribution));
+    json_object_set_new(rootJ, "mode", json_integer(mode));
+    return rootJ;
+  }
+
+  void dataFromJson(json_t *rootJ) override {
+    json_t *seedJ = json_object_get(rootJ, "seed");
+    if (seedJ) {
+      reseed(json_integer_value(seedJ));
+    }
+    json_t *distributionJ = json_object_get(rootJ, "distribution");
+    if (distributionJ) {
+      distribution = clamp((int)json_integer_value(distributionJ), 0, DISTRIBUTIONS_LEN - 1);
+    }
+    json_t *modeJ = json_object_get(rootJ, "mode");
+    if (modeJ) {
+      mode = clamp((int)json_integer_value(modeJ), MODE_BURST, MODE_CONTINUOUS);
+    }
+  }
+
+  // The output channel for the next voice of a burst in MODE_BURST_PER_CHANNEL. Idle channels,
+  // whose voice has already triggered, are taken in turn. Only when every channel is still waiting
+  // is one stolen, again in turn, and its pending trigger dropped.
+  int takeVoice() {
+    int voice = nextVoice;
+    for (int k = 0; k < 16; k++) {
+      int i = (nextVoice + k) % 16;
+      if (countdown[i] < 0) {
+        voice = i;
+        break;
+      }
+    }
+    nextVoice = (voice + 1) % 16;
+    return voice;
+  }
+
+  // Time scaled by the time input, which follows the trigger channel if it is polyphonic
+  float getTime(int c) {
+    Input &timeInput = getInput(DELAY_TIME_INPUT);
+    return getParam(DELAY_TIME_PARAM).getValue() * (timeInput.isConnected() ? timeInput.getPolyVoltage(c) / 10.f : 1.f);
+  }
+
+  float nextInterval() {
+    if (intervalsLeft == 0) {
+      rng.uniform(intervals);
+      intervalTable.lookup(intervals, intervals);
+      intervalsLeft = 4;
+    }
+    return intervals[--intervalsLeft];
   }
 
   void process(const ProcessArgs &args) override {
     if (uiDivider.process()) {
-      channels = static_cast<float>(getParam(VOICES_PARAM).getValue());
+      voices = getParam(VOICES_PARAM).getValue();
+      channels = mode == MODE_BURST_PER_CHANNEL ? 16 : voices;
       getOutput(TRIGGER_OUTPUT).setChannels(channels);
+
+      float newBias = getParam(BIAS_PARAM).getValue();
+      if (newBias != bias || distribution != tableDistribution) {
+        bias = newBias;
+        tableDistribution = distribution;
+        burstTable.fillPower(bias);
+        burstTable.compose(distributions[tableDistribution]);
+      }
+
+      continuous = mode == MODE_CONTINUOUS;
+      if (continuous) {
+        // The voices share the mean interval set by the time, so together they keep its rate
+        float newMean = std::max(getTime(0) * voices, MIN_INTERVAL) * args.sampleRate;
+        if (meanInterval > 0.f && newMean != meanInterval) {
+          float scale = newMean / meanInterval;
+          for (int i = 0; i < 16; i++) {
+            if (countdown[i] > 0) {
+              countdown[i] *= scale;
+            }
+          }
+        }
+        meanInterval = newMean;
+        minInterval = MIN_INTERVAL * args.sampleRate;
+      } else {
+        meanInterval = 0.f;
+      }
     }
 
-    timer.process(args.sampleTime);
+    if (seedTrig.process(getInput(SEED_INPUT).getVoltage() > 0.f)) {
+      restart();
+    }
 
-    for (size_t i = 0; i < channels; i++) {
-      if (armed[i] && timer.getTime() > delay[i]) {
+    for (int i = 0; i < channels; i++) {
+      if (countdown[i] >= 0 && countdown[i]-- == 0) {
         trigs[i].trigger();
-        armed[i] = false;
+      }
+      if (continuous && countdown[i] < 0) {
+        countdown[i] = std::max((int32_t)(nextInterval() * meanInterval), minInterval);
       }
       getOutput(TRIGGER_OUTPUT).setVoltage(trigs[i].process(args.sampleTime) * 10.f, i);
     }
 
-    if (inputTrig.process(getInput(TRIGGER_INPUT).getVoltageSum() > 0.f)) {
-      timer.reset();
-      for (size_t i = 0; i < channels; i++) {
-        armed[i] = true;
-        // delay[i] = std::pow(random::uniform(), getParam(BIAS_PARAM).getValue()) * getParam(DELAY_TIME_PARAM).getValue() * (getInput(DELAY_TIME_INPUT).isConnected() ? getInput(DELAY_TIME_INPUT).getVoltage() / 10.f : 1.f);
-        delay[i] = random::uniform() * getParam(DELAY_TIME_PARAM).getValue() * (getInput(DELAY_TIME_INPUT).isConnected() ? getInput(DELAY_TIME_INPUT).getVoltage() / 10.f : 1.f);
+    Input &triggerInput = getInput(TRIGGER_INPUT);
+    int32_t samples[16];
+    if (mode == MODE_BURST) {
+      if (inputTrig.process(triggerInput.getVoltageSum() > 0.f)) {
+        drawCountdowns(rng, burstTable, voices, getTime(0) * args.sampleRate, samples);
+        for (int i = 0; i < voices; i++) {
+          countdown[i] = samples[i];
+        }
       }
-    };
+    } else if (mode == MODE_BURST_PER_CHANNEL) {
+      int triggerChannels = triggerInput.getChannels();
+      for (int c = 0; c < triggerChannels; c += 4) {
+        int fired = simd::movemask(channelTrig[c / 4].process(triggerInput.getVoltageSimd<simd::float_4>(c)));
+        // Lanes past the last channel hold stale voltages
+        fired &= (1 << std::min(triggerChannels - c, 4)) - 1;
+        for (int lane = 0; fired; lane++, fired >>= 1) {
+          if (fired & 1) {
+            drawCountdowns(rng, burstTable, voices, getTime(c + lane) * args.sampleRate, samples);
+            for (int i = 0; i < voices; i++) {
+              countdown[takeVoice()] = samples[i];
+            }
+          }
+        }
+      }
+    }
   }
 };
 
@@ -78,12 +247,24 @@ struct SprayWidget : ModuleWidget {
 
     addParam(createParamCentered<LilacKnob>(mm2px(Vec(7.62, 56.622)), module, Spray::DELAY_TIME_PARAM));
     addParam(createParamCentered<LilacKnob>(mm2px(Vec(7.62, 91.018)), module, Spray::VOICES_PARAM));
+    addParam(createParamCentered<LilacKnob>(mm2px(Vec(22.86, 56.622)), module, Spray::BIAS_PARAM));
 
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 33.352)), module, Spray::TRIGGER_INPUT));
     addInput(createInputCentered<LilacPort>(mm2px(Vec(7.62, 69.801)), module, Spray::DELAY_TIME_INPUT));
+    addInput(createInputCentered<LilacPort>(mm2px(Vec(22.86, 33.352)), module, Spray::SEED_INPUT));
 
     addOutput(createOutputCentered<LilacPort>(mm2px(Vec(7.62, 112.359)), module, Spray::TRIGGER_OUTPUT));
   }
+
+  void appendContextMenu(Menu *menu) override {
+    Spray *module = getModule<Spray>();
+    menu->addChild(new MenuSeparator);
+    menu->addChild(createMenuItem("New random seed", "", [=]() {
+      module->reseed(random::u32());
+    }));
+    menu->addChild(createIndexPtrSubmenuItem("Distribution", {"Uniform", "Exponential", "Gaussian", "Clustered"}, &module->distribution));
+    menu->addChild(createIndexPtrSubmenuItem("Mode", {"One burst from all channels", "One burst per channel", "Continuous random triggers"}, &module->mode));
+  }
 };
 
 Model *modelSpray = createModel<Spray, SprayWidget>("Spray");
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+
+// Accumulated sums for 16 channels plus memory slots that can be stored and recalled in
+// constant time. Every bank is a single 64-byte cache line. Sums are read from one bank and
+// written to another on each sample, so storing or recalling only changes which bank is read
+// next. Nothing is copied or allocated on the audio thread.
+struct SumBanks {
+  static const int SLOTS = 8;
+
+  float storage[(SLOTS + 2) * 16];
+  float *banks;
+  int slots[SLOTS];
+  int read = SLOTS;
+  int write = SLOTS;
+
+  SumBanks() {
+    // Align the banks to a cache line within storage, since aligned new isn't available in C++11
+    banks = reinterpret_cast<float *>((reinterpret_cast<uintptr_t>(storage) + 63) & ~static_cast<uintptr_t>(63));
+    reset();
+  }
+
+  SumBanks(const SumBanks &) = delete;
+  SumBanks &operator=(const SumBanks &) = delete;
+
+  void reset() {
+    for (int i = 0; i < (SLOTS + 1) * 16; i++) {
+      banks[i] = 0.f;
+    }
+    for (int i = 0; i < SLOTS; i++) {
+      slots[i] = i;
+    }
+    read = write = SLOTS;
+  }
+
+  // Sums from the previous sample
+  const float *current() const {
+    return &banks[read * 16];
+  }
+
+  // Destination for this sample's sums
+  float *next() {
+    return &banks[write * 16];
+  }
+
+  // Make the sums written to next() current. Channels from written onwards weren't written, and
+  // keep their current sums.
+  void advance(int written = 16) {
+    if (read != write) {
+      for (int c = written; c < 16; c++) {
+        banks[write * 16 + c] = banks[read * 16 + c];
+      }
+    }
+    read = write;
+  }
+
+  // Keep the current sums in a slot by trading banks with it
+  void store(int slot) {
+    if (read == write) {
+      std::swap(slots[slot], write);
+      read = slots[slot];
+    }
+    // Sums still come from another slot after a recall, so that slot must stay intact
+    else if (read != slots[slot]) {
+      for (int c = 0; c < 16; c++) {
+        banks[slots[slot] * 16 + c] = banks[read * 16 + c];
+      }
+    }
+  }
+
+  // Continue from a slot. The slot is only read from, so it can be recalled again later.
+  void recall(int slot) {
+    read = slots[slot];
+  }
+
+  const float *slot(int slot) const {
+    return &banks[slots[slot] * 16];
+  }
+
+  float *slot(int slot) {
+    return &banks[slots[slot] * 16];
+  }
+
+  // Writable current sums for use outside the audio thread, e.g. when loading a patch
+  float *edit() {
+    if (read != write) {
+      for (int c = 0; c < 16; c++) {
+        banks[write * 16 + c] = banks[read * 16 + c];
+      }
+      read = write;
+    }
+    return next();
+  }
+};
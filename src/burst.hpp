@@ -0,0 +1,20 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "xoshiro.hpp"
+#include "distribution.hpp"
+
+// Draws the samples until each voice of a burst triggers, four voices at a time. Uniform numbers
+// from the generator are shaped by the table and scaled by the length of the burst in samples,
+// so the same seed and table always give the same countdowns. samples needs room for the voices
+// rounded up to a multiple of four.
+inline void drawCountdowns(Xoshiro128x4 &rng, const DistributionTable &table, int voices, float length, int32_t *samples) {
+  for (int c = 0; c < voices; c += 4) {
+    float u[4];
+    rng.uniform(u);
+    table.lookup(u, u);
+    for (int lane = 0; lane < 4; lane++) {
+      samples[c + lane] = (int32_t)std::max(u[lane] * length, 0.f);
+    }
+  }
+}
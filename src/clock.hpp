@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+
+// Estimates the period of a clock in samples as the median of the most recent intervals between
+// its edges, so a single late or doubled pulse doesn't throw the estimate off
+struct ClockPeriod {
+  static const int INTERVALS = 5;
+
+  // Samples since the last edge
+  uint32_t elapsed = 0;
+  // Zero until two edges have been seen
+  uint32_t period = 0;
+  bool started = false;
+  uint32_t intervals[INTERVALS];
+  int intervalCount = 0;
+  int intervalIndex = 0;
+
+  void reset() {
+    elapsed = period = 0;
+    started = false;
+    intervalCount = intervalIndex = 0;
+  }
+
+  // Call once per sample
+  void process(bool edge) {
+    elapsed++;
+    if (edge) {
+      if (started) {
+        addInterval(elapsed);
+      }
+      started = true;
+      elapsed = 0;
+    }
+  }
+
+  void addInterval(uint32_t interval) {
+    intervals[intervalIndex] = interval;
+    intervalIndex = (intervalIndex + 1) % INTERVALS;
+    if (intervalCount < INTERVALS) {
+      intervalCount++;
+    }
+
+    // Insertion sort, which is quick for five values
+    uint32_t sorted[INTERVALS];
+    for (int i = 0; i < intervalCount; i++) {
+      int j = i;
+      for (; j > 0 && sorted[j - 1] > intervals[i]; j--) {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = intervals[i];
+    }
+    period = sorted[intervalCount / 2];
+  }
+
+  // Fraction of the period that a number of samples makes up, such as the samples since the last
+  // edge. It is held at 1 if the next edge is late, and 0 until the period is known.
+  float phase(uint32_t samples) const {
+    return period ? std::min(samples / (float)period, 1.f) : 0.f;
+  }
+};
+
+// Evenly spaced triggers between the edges of a clock, restarted on every edge so they never drift
+struct ClockMultiplier {
+  int factor = 1;
+  // Sub-triggers already sent since the last edge
+  int step = 0;
+
+  // Returns true on the samples that should trigger
+  bool process(bool edge, const ClockPeriod &clockPeriod) {
+    if (edge) {
+      step = 1;
+      return true;
+    }
+    if (step < factor && clockPeriod.period && (uint64_t)clockPeriod.elapsed * factor >= (uint64_t)clockPeriod.period * step) {
+      step++;
+      return true;
+    }
+    return false;
+  }
+};
@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// A curve from [0, 1] stored as a table, so random numbers can be shaped with one lookup and a
+// linear interpolation instead of calls to transcendental functions. Filling the table is the
+// expensive part, and only needs to happen when the curve changes.
+struct DistributionTable {
+  static const int SIZE = 256;
+
+  float values[SIZE + 1];
+
+  DistributionTable() {
+    for (int i = 0; i <= SIZE; i++) {
+      values[i] = i / (float)SIZE;
+    }
+  }
+
+  template <typename F>
+  void fill(F curve) {
+    for (int i = 0; i <= SIZE; i++) {
+      values[i] = curve(i / (float)SIZE);
+    }
+  }
+
+  // u to the power of exponent, for exponents of 0 and up. It is built from log2(u), which never
+  // changes, and a fast exp2, so it is cheap enough to refill on the audio thread.
+  void fillPower(float exponent) {
+    const float *log2u = log2Table();
+    values[0] = exponent > 0.f ? 0.f : 1.f;
+    for (int i = 1; i <= SIZE; i++) {
+      values[i] = exp2(exponent * log2u[i]);
+    }
+  }
+
+  // Passes every value through another curve on [0, 1], so one lookup gives the value of both
+  void compose(const DistributionTable &outer) {
+    for (int i = 0; i <= SIZE; i++) {
+      values[i] = outer.lookup(values[i]);
+    }
+  }
+
+  // log2(i / SIZE), computed the first time it is asked for
+  static const float *log2Table() {
+    struct Table {
+      float values[SIZE + 1];
+
+      Table() {
+        values[0] = -INFINITY;
+        for (int i = 1; i <= SIZE; i++) {
+          values[i] = std::log2(i / (float)SIZE);
+        }
+      }
+    };
+    static const Table table;
+    return table.values;
+  }
+
+  // 2^x from the exponent bits and a Taylor polynomial for the fraction, within 1e-4 of the exact
+  // value relative to it. Anything below 2^-126 comes out as 2^-126.
+  static float exp2(float x) {
+    x = std::max(x, -126.f);
+    float whole = std::floor(x);
+    float f = x - whole;
+    float fraction = 1.f + f * (0.69314718f + f * (0.24022651f + f * (0.05550411f + f * (0.00961813f + f * 0.00133336f))));
+    int32_t bits = ((int32_t)whole + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return scale * fraction;
+  }
+
+  // u in [0, 1]
+  float lookup(float u) const {
+    float x = u * SIZE;
+    int i = (int)x;
+    if (i >= SIZE) {
+      return values[SIZE];
+    }
+    return values[i] + (x - i) * (values[i + 1] - values[i]);
+  }
+
+  // Four lookups at once, for u in [0, 1]. out may be the same array as u.
+  void lookup(const float *u, float *out) const {
+#if defined(__SSE2__)
+    // Vector loads and stores, so the caller can load the result as a vector without a stall
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(u), _mm_set1_ps(SIZE));
+    // At u = 1, interpolate to the end of the last segment rather than reading past the table
+    __m128i i = _mm_cvttps_epi32(_mm_min_ps(x, _mm_set1_ps(SIZE - 1)));
+    __m128 fraction = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+    int index[4];
+    _mm_storeu_si128((__m128i *)index, i);
+    __m128 low = _mm_setr_ps(values[index[0]], values[index[1]], values[index[2]], values[index[3]]);
+    __m128 high = _mm_setr_ps(values[index[0] + 1], values[index[1] + 1], values[index[2] + 1], values[index[3] + 1]);
+    _mm_storeu_ps(out, _mm_add_ps(low, _mm_mul_ps(fraction, _mm_sub_ps(high, low))));
+#else
+    for (int lane = 0; lane < 4; lane++) {
+      out[lane] = lookup(u[lane]);
+    }
+#endif
+  }
+};
+
+// Inverse cumulative distribution functions on [0, 1], which turn uniform random numbers into
+// numbers that follow each distribution. They are slow, and only meant for filling tables.
+namespace distribution {
+
+// Exponential, as the gaps in a Poisson process, cut off at 1 with most values below 0.25
+inline float exponential(float u) {
+  const float rate = 4.f;
+  return std::min(-std::log(1.f - u * (1.f - std::exp(-rate))) / rate, 1.f);
+}
+
+// Exponential with a mean of 1, for the intervals between the events of a Poisson process. It is
+// cut off at 8, which moves the mean by less than 0.3%.
+inline float interval(float u) {
+  const float cutoff = 8.f;
+  return -std::log(1.f - u * (1.f - std::exp(-cutoff)));
+}
+
+// Normal around 0.5 with a standard deviation of 1/6, cut off at 0 and 1, inverted by bisection
+inline float gaussian(float u) {
+  const float sigma = 1.f / 6.f;
+  auto cdf = [=](float x) {
+    return std::erf((x - 0.5f) / (sigma * std::sqrt(2.f)));
+  };
+  float target = cdf(0.f) + u * (cdf(1.f) - cdf(0.f));
+  float low = 0.f;
+  float high = 1.f;
+  for (int i = 0; i < 32; i++) {
+    float middle = (low + high) / 2.f;
+    if (cdf(middle) < target) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return (low + high) / 2.f;
+}
+
+// Four evenly spaced narrow normal clusters, with gaps between them
+inline float clustered(float u) {
+  const int clusters = 4;
+  float x = u * clusters;
+  int k = std::min((int)x, clusters - 1);
+  return (k + 0.5f + 0.5f * (gaussian(x - k) - 0.5f)) / clusters;
+}
+
+} // namespace distribution
+
+enum Distribution {
+  DISTRIBUTION_UNIFORM,
+  DISTRIBUTION_EXPONENTIAL,
+  DISTRIBUTION_GAUSSIAN,
+  DISTRIBUTION_CLUSTERED,
+  DISTRIBUTIONS_LEN
+};
+
+// One table per distribution, shared by every module and filled the first time they are asked for
+inline const DistributionTable *distributionTables() {
+  struct Tables {
+    DistributionTable tables[DISTRIBUTIONS_LEN];
+
+    Tables() {
+      tables[DISTRIBUTION_EXPONENTIAL].fill(distribution::exponential);
+      tables[DISTRIBUTION_GAUSSIAN].fill(distribution::gaussian);
+      tables[DISTRIBUTION_CLUSTERED].fill(distribution::clustered);
+    }
+  };
+  static const Tables tables;
+  return tables.tables;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <cmath>
+
+// Half-band filters for oversampling by powers of two, as polyphase stages that each double or
+// halve the rate. T may be float or a SIMD vector to filter several channels at once.
+//
+// Every other tap of a half-band filter is zero, so a stage only uses the 2 * M taps of its odd
+// phase, and since those are symmetric only M multiplications. The even phase is a plain delay.
+
+// Odd-phase taps of a windowed-sinc half-band filter, normalized to unity gain at DC
+inline void halfBandTaps(float *taps, int m) {
+  float sum = 0.f;
+  for (int j = 0; j < 2 * m; j++) {
+    // Offset from the centre of the filter, in samples at the higher rate
+    float k = 2 * j - 2 * m + 1;
+    float sinc = std::sin(M_PI * k / 2) / (M_PI * k / 2);
+    float window = 0.42f + 0.5f * std::cos(M_PI * k / (2 * m)) + 0.08f * std::cos(2 * M_PI * k / (2 * m));
+    taps[j] = sinc * window;
+    sum += taps[j];
+  }
+  for (int j = 0; j < 2 * m; j++) {
+    taps[j] /= sum;
+  }
+}
+
+// Doubles the sample rate, with a latency of M input samples
+template <typename T, int M = 8>
+struct HalfBandInterpolator {
+  float taps[2 * M];
+  // Input history, stored twice so the newest 2 * M samples are always contiguous
+  T history[4 * M];
+  int pos = 0;
+
+  HalfBandInterpolator() {
+    halfBandTaps(taps, M);
+    reset();
+  }
+
+  void reset() {
+    for (int i = 0; i < 4 * M; i++) {
+      history[i] = T(0.f);
+    }
+    pos = 0;
+  }
+
+  void process(T in, T *out) {
+    pos = pos > 0 ? pos - 1 : 2 * M - 1;
+    history[pos] = history[pos + 2 * M] = in;
+
+    const T *x = &history[pos];
+    T half = T(0.f);
+    for (int j = 0; j < M; j++) {
+      half += taps[j] * (x[j] + x[2 * M - 1 - j]);
+    }
+    out[0] = x[M];
+    out[1] = half;
+  }
+};
+
+// Halves the sample rate, with a latency of M - 1 output samples
+template <typename T, int M = 8>
+struct HalfBandDecimator {
+  float taps[2 * M];
+  T odd[4 * M];
+  T even[M];
+  int oddPos = 0;
+  int evenPos = 0;
+
+  HalfBandDecimator() {
+    halfBandTaps(taps, M);
+    reset();
+  }
+
+  void reset() {
+    for (int i = 0; i < 4 * M; i++) {
+      odd[i] = T(0.f);
+    }
+    for (int i = 0; i < M; i++) {
+      even[i] = T(0.f);
+    }
+    oddPos = evenPos = 0;
+  }
+
+  T process(T in0, T in1) {
+    oddPos = oddPos > 0 ? oddPos - 1 : 2 * M - 1;
+    odd[oddPos] = odd[oddPos + 2 * M] = in1;
+    evenPos = (evenPos + 1) % M;
+    even[evenPos] = in0;
+
+    // The taps are symmetric, so the window can be read newest first
+    const T *x = &odd[oddPos];
+    T sum = T(0.f);
+    for (int j = 0; j < M; j++) {
+      sum += taps[j] * (x[j] + x[2 * M - 1 - j]);
+    }
+    return 0.5f * (sum + even[(evenPos + 1) % M]);
+  }
+};
+
+// Delay of a HalfBandUpsampler followed by a HalfBandDownsampler of the same factor, in samples
+// at the lower rate. Each doubling adds 2 * M - 1 samples at the rate it runs at.
+inline float halfBandLatency(int factor, int m = 8) {
+  return (2 * m - 1) * 2.f * (factor - 1) / factor;
+}
+
+// Cascades of half-band stages for 1x, 2x, 4x or 8x oversampling
+template <typename T, int M = 8>
+struct HalfBandUpsampler {
+  static const int MAX_FACTOR = 8;
+
+  HalfBandInterpolator<T, M> stages[3];
+  int factor = 1;
+
+  void setFactor(int factor) {
+    if (factor != this->factor) {
+      this->factor = factor;
+      for (int s = 0; s < 3; s++) {
+        stages[s].reset();
+      }
+    }
+  }
+
+  // Writes factor samples to out
+  void process(T in, T *out) {
+    T buffer[MAX_FACTOR];
+    out[0] = in;
+    for (int n = 1, s = 0; n < factor; n *= 2, s++) {
+      for (int i = 0; i < n; i++) {
+        buffer[i] = out[i];
+      }
+      for (int i = 0; i < n; i++) {
+        stages[s].process(buffer[i], &out[2 * i]);
+      }
+    }
+  }
+};
+
+template <typename T, int M = 8>
+struct HalfBandDownsampler {
+  HalfBandDecimator<T, M> stages[3];
+  int factor = 1;
+
+  void setFactor(int factor) {
+    if (factor != this->factor) {
+      this->factor = factor;
+      for (int s = 0; s < 3; s++) {
+        stages[s].reset();
+      }
+    }
+  }
+
+  // Reads factor samples from in, which is used as scratch space
+  T process(T *in) {
+    for (int n = factor / 2, s = 0; n >= 1; n /= 2, s++) {
+      for (int i = 0; i < n; i++) {
+        in[i] = stages[s].process(in[2 * i], in[2 * i + 1]);
+      }
+    }
+    return in[0];
+  }
+};
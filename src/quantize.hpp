@@ -0,0 +1,38 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The source closest to x. sources must not be empty.
+inline float quantize(const std::vector<float> &sources, float x) {
+  float closest = sources[0];
+  for (float source : sources) {
+    if (std::fabs(source - x) < std::fabs(closest - x)) {
+      closest = source;
+    }
+  }
+  return closest;
+}
+
+// The sources in ascending order, spread evenly over the range from the lowest to the highest, and
+// the one whose place in that order is closest to x. sources must not be empty.
+inline float quantizeProportional(const std::vector<float> &sources, float x) {
+  std::vector<float> sorted = sources;
+  std::sort(sorted.begin(), sorted.end());
+  float low = sorted.front();
+  float high = sorted.back();
+  if (high <= low) {
+    return low;
+  }
+  int last = (int)sorted.size() - 1;
+  int i = (int)std::round((x - low) / (high - low) * last);
+  return sorted[std::min(std::max(i, 0), last)];
+}
+
+// The range from min to max split into one equal step per source, in the order given, and the
+// source of the step x is in. Values outside the range take the first or the last source.
+inline float scan(const std::vector<float> &sources, float min, float max, float x) {
+  int last = (int)sources.size() - 1;
+  int i = (int)std::floor((x - min) / (max - min) * sources.size());
+  return sources[std::min(std::max(i, 0), last)];
+}
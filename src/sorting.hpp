@@ -0,0 +1,118 @@
+#pragma once
+#include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSE2__)
+namespace sorting {
+
+// Four values, each with the input channel it came from
+struct Lanes {
+  __m128 value;
+  __m128 channel;
+};
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Put the lower of each pair of lanes in a and the higher in b
+inline void compareExchange(Lanes &a, Lanes &b) {
+  __m128 swap = _mm_cmpgt_ps(a.value, b.value);
+  Lanes low = {select(swap, b.value, a.value), select(swap, b.channel, a.channel)};
+  b = {select(swap, a.value, b.value), select(swap, a.channel, b.channel)};
+  a = low;
+}
+
+// Two lanes of a followed by two lanes of b, chosen by _MM_SHUFFLE
+template <int Mask>
+inline Lanes shuffle(const Lanes &a, const Lanes &b) {
+  return {_mm_shuffle_ps(a.value, b.value, Mask), _mm_shuffle_ps(a.channel, b.channel, Mask)};
+}
+
+inline Lanes reverse(const Lanes &a) {
+  return shuffle<_MM_SHUFFLE(0, 1, 2, 3)>(a, a);
+}
+
+// Sort the lanes of two bitonic registers independently
+inline void bitonicClean(Lanes &a, Lanes &b) {
+  // Lanes two apart
+  Lanes low = shuffle<_MM_SHUFFLE(1, 0, 1, 0)>(a, b);
+  Lanes high = shuffle<_MM_SHUFFLE(3, 2, 3, 2)>(a, b);
+  compareExchange(low, high);
+  // Neighbouring lanes, from a0 a1 b0 b1 and a2 a3 b2 b3
+  Lanes even = shuffle<_MM_SHUFFLE(2, 0, 2, 0)>(low, high);
+  Lanes odd = shuffle<_MM_SHUFFLE(3, 1, 3, 1)>(low, high);
+  compareExchange(even, odd);
+  // Interleave back into a0 a1 a2 a3 and b0 b1 b2 b3
+  a = shuffle<_MM_SHUFFLE(3, 1, 2, 0)>(shuffle<_MM_SHUFFLE(2, 0, 2, 0)>(even, odd), shuffle<_MM_SHUFFLE(2, 0, 2, 0)>(even, odd));
+  b = shuffle<_MM_SHUFFLE(3, 1, 2, 0)>(shuffle<_MM_SHUFFLE(3, 1, 3, 1)>(even, odd), shuffle<_MM_SHUFFLE(3, 1, 3, 1)>(even, odd));
+}
+
+// Merge two sorted registers into eight sorted lanes
+inline void merge4(Lanes &a, Lanes &b) {
+  b = reverse(b);
+  compareExchange(a, b);
+  bitonicClean(a, b);
+}
+
+} // namespace sorting
+#endif
+
+// Sort 16 values in ascending order, moving the input channel each came from along with it. With
+// SSE2 this is a fixed bitonic network, which runs the same comparisons on every call without
+// branches. Otherwise it is an insertion sort. Values that compare equal may come out in a
+// different order on the two paths. Unused lanes can be padded with INFINITY to sort to the end.
+inline void sort16(float *values, float *channels) {
+#if defined(__SSE2__)
+  using namespace sorting;
+  Lanes r[4];
+  for (int c = 0; c < 16; c += 4) {
+    r[c / 4] = {_mm_loadu_ps(&values[c]), _mm_loadu_ps(&channels[c])};
+  }
+
+  // Sort each column of lanes across the four registers
+  compareExchange(r[0], r[1]);
+  compareExchange(r[2], r[3]);
+  compareExchange(r[0], r[2]);
+  compareExchange(r[1], r[3]);
+  compareExchange(r[1], r[2]);
+
+  // so that after transposing, each register is sorted
+  _MM_TRANSPOSE4_PS(r[0].value, r[1].value, r[2].value, r[3].value);
+  _MM_TRANSPOSE4_PS(r[0].channel, r[1].channel, r[2].channel, r[3].channel);
+
+  merge4(r[0], r[1]);
+  merge4(r[2], r[3]);
+
+  // Merge the two sorted halves
+  Lanes high0 = reverse(r[3]);
+  Lanes high1 = reverse(r[2]);
+  compareExchange(r[0], high0);
+  compareExchange(r[1], high1);
+  r[2] = high0;
+  r[3] = high1;
+  compareExchange(r[0], r[1]);
+  compareExchange(r[2], r[3]);
+  bitonicClean(r[0], r[1]);
+  bitonicClean(r[2], r[3]);
+
+  for (int c = 0; c < 16; c += 4) {
+    _mm_storeu_ps(&values[c], r[c / 4].value);
+    _mm_storeu_ps(&channels[c], r[c / 4].channel);
+  }
+#else
+  for (int i = 1; i < 16; i++) {
+    float value = values[i];
+    float channel = channels[i];
+    int j = i;
+    for (; j > 0 && values[j - 1] > value; j--) {
+      values[j] = values[j - 1];
+      channels[j] = channels[j - 1];
+    }
+    values[j] = value;
+    channels[j] = channel;
+  }
+#endif
+}
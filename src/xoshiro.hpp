@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+
+// Small, fast pseudorandom generator (xoshiro128+) owned by a module, so a saved seed always
+// replays the same sequence. See https://prng.di.unimi.it/
+struct Xoshiro128 {
+  uint32_t s[4];
+
+  Xoshiro128(uint64_t seed = 0) {
+    this->seed(seed);
+  }
+
+  // Expand the seed with splitmix64, which never leaves the state all zero
+  void seed(uint64_t seed) {
+    for (int i = 0; i < 4; i += 2) {
+      uint64_t z = splitmix64(seed);
+      s[i] = (uint32_t)z;
+      s[i + 1] = (uint32_t)(z >> 32);
+    }
+  }
+
+  static uint64_t splitmix64(uint64_t &x) {
+    x += 0x9e3779b97f4a7c15;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  static uint32_t rotl(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+  }
+
+  uint32_t next() {
+    uint32_t result = s[0] + s[3];
+    uint32_t t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+    return result;
+  }
+
+  // Uniform in [0, 1), from the upper 24 bits, which are the best distributed
+  float uniform() {
+    return (next() >> 8) * (1.f / 16777216.f);
+  }
+};
+
+// Four independent xoshiro128+ streams, so a single call gives four uniforms. The lanes are
+// updated side by side in plain loops, which compilers turn into SSE or NEON instructions.
+struct Xoshiro128x4 {
+  // Word i of the state of each lane
+  uint32_t s[4][4];
+
+  Xoshiro128x4(uint64_t seed = 0) {
+    this->seed(seed);
+  }
+
+  void seed(uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+      for (int lane = 0; lane < 4; lane += 2) {
+        uint64_t z = Xoshiro128::splitmix64(seed);
+        s[i][lane] = (uint32_t)z;
+        s[i][lane + 1] = (uint32_t)(z >> 32);
+      }
+    }
+  }
+
+  void next(uint32_t *result) {
+    for (int lane = 0; lane < 4; lane++) {
+      result[lane] = s[0][lane] + s[3][lane];
+      uint32_t t = s[1][lane] << 9;
+      s[2][lane] ^= s[0][lane];
+      s[3][lane] ^= s[1][lane];
+      s[1][lane] ^= s[2][lane];
+      s[0][lane] ^= s[3][lane];
+      s[2][lane] ^= t;
+      s[3][lane] = Xoshiro128::rotl(s[3][lane], 11);
+    }
+  }
+
+  // Four uniforms in [0, 1)
+  void uniform(float *u) {
+    uint32_t result[4];
+    next(result);
+    for (int lane = 0; lane < 4; lane++) {
+      u[lane] = (result[lane] >> 8) * (1.f / 16777216.f);
+    }
+  }
+};
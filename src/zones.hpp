@@ -0,0 +1,21 @@
+#pragma once
+
+// Each threshold splits the voltage range in two, and the zone of a voltage is the number of
+// thresholds at or below it. That doesn't depend on the order of the thresholds, so they never
+// need to be sorted. Writes the zones of all 16 voltages in a, so the loops have a fixed length
+// the compiler can vectorise, and returns a bit for each zone that one of the first channels is in.
+inline int findZones(const float *a, int channels, const float *thresholds, int count, float *zones) {
+  for (int c = 0; c < 16; c++) {
+    zones[c] = 0.f;
+  }
+  for (int i = 0; i < count; i++) {
+    for (int c = 0; c < 16; c++) {
+      zones[c] += a[c] >= thresholds[i] ? 1.f : 0.f;
+    }
+  }
+  int active = 0;
+  for (int c = 0; c < channels; c++) {
+    active |= 1 << (int)zones[c];
+  }
+  return active;
+}
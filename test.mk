@@ -1,6 +1,6 @@
 .PHONY: test
 
-test.out: test/test.cpp
+test.out: test/test.cpp src/*.hpp
 	$(CXX) -std=c++11 -Isrc/ test/test.cpp -o test/test.out
 
 test: test.out
@@ -1,6 +1,14 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "quantize.hpp"
+#include "clock.hpp"
+#include "xoshiro.hpp"
+#include "distribution.hpp"
+#include "burst.hpp"
+#include "SumBanks.hpp"
+#include "sorting.hpp"
+#include "oversample.hpp"
+#include "zones.hpp"
 
 TEST_CASE("Quantize", "[]") {
   std::vector<float> sources = {-5.f, 4.f, 5.f};
@@ -41,3 +49,277 @@ TEST_CASE("Scan", "[]") {
   REQUIRE(scan(sources, 0.f, 10.f, 09.9f) == Approx(4.56f));
   REQUIRE(scan(sources, 0.f, 1.f, 100.f) == Approx(4.56f));
 }
+
+TEST_CASE("Clock period", "[]") {
+  ClockPeriod clockPeriod;
+  // Edges 100 samples apart, with one pulse arriving 40 samples late
+  int intervals[] = {100, 100, 140, 60, 100};
+  clockPeriod.process(true);
+  for (int interval : intervals) {
+    for (int i = 1; i < interval; i++) {
+      clockPeriod.process(false);
+    }
+    clockPeriod.process(true);
+  }
+  REQUIRE(clockPeriod.period == 100);
+  for (int i = 0; i < 50; i++) {
+    clockPeriod.process(false);
+  }
+  REQUIRE(clockPeriod.phase(clockPeriod.elapsed) == Approx(0.5f));
+  REQUIRE(clockPeriod.phase(150) == Approx(1.f));
+
+  ClockMultiplier clockMultiplier;
+  clockMultiplier.factor = 4;
+  int triggers = 0;
+  for (int i = 0; i < 100; i++) {
+    bool edge = i == 0;
+    clockPeriod.process(edge);
+    triggers += clockMultiplier.process(edge, clockPeriod);
+  }
+  REQUIRE(triggers == 4);
+}
+
+TEST_CASE("Seeded random", "[]") {
+  Xoshiro128x4 a(1234);
+  Xoshiro128x4 b(1234);
+  Xoshiro128x4 c(1235);
+  bool differs = false;
+  for (int i = 0; i < 1000; i++) {
+    float x[4], y[4], z[4];
+    a.uniform(x);
+    b.uniform(y);
+    c.uniform(z);
+    for (int lane = 0; lane < 4; lane++) {
+      REQUIRE(x[lane] == y[lane]);
+      REQUIRE(x[lane] >= 0.f);
+      REQUIRE(x[lane] < 1.f);
+      differs |= x[lane] != z[lane];
+    }
+  }
+  REQUIRE(differs);
+
+  // Reseeding replays the sequence
+  float first[4], replay[4];
+  a.seed(99);
+  a.uniform(first);
+  a.seed(99);
+  a.uniform(replay);
+  for (int lane = 0; lane < 4; lane++) {
+    REQUIRE(first[lane] == replay[lane]);
+  }
+}
+
+TEST_CASE("Distribution tables", "[]") {
+  const DistributionTable *tables = distributionTables();
+  for (int d = 0; d < DISTRIBUTIONS_LEN; d++) {
+    for (int i = 0; i < DistributionTable::SIZE; i++) {
+      REQUIRE(tables[d].values[i] <= tables[d].values[i + 1]);
+    }
+    REQUIRE(tables[d].values[0] >= 0.f);
+    REQUIRE(tables[d].values[DistributionTable::SIZE] <= 1.f);
+  }
+  REQUIRE(tables[DISTRIBUTION_UNIFORM].lookup(0.3f) == Approx(0.3f));
+  REQUIRE(tables[DISTRIBUTION_EXPONENTIAL].lookup(0.5f) < 0.25f);
+  REQUIRE(tables[DISTRIBUTION_GAUSSIAN].lookup(0.5f) == Approx(0.5f));
+
+  DistributionTable intervalTable;
+  intervalTable.fill(distribution::interval);
+  float mean = 0.f;
+  for (int i = 0; i < 10000; i++) {
+    mean += intervalTable.lookup((i + 0.5f) / 10000) / 10000;
+  }
+  REQUIRE(mean == Approx(1.f).epsilon(0.01));
+
+  float u[4] = {0.f, 0.3f, 0.77f, 1.f};
+  float x[4];
+  tables[DISTRIBUTION_GAUSSIAN].lookup(u, x);
+  for (int lane = 0; lane < 4; lane++) {
+    REQUIRE(x[lane] == Approx(tables[DISTRIBUTION_GAUSSIAN].lookup(u[lane])));
+  }
+
+  DistributionTable power;
+  for (float exponent : {1.f, 2.5f, 32.f}) {
+    power.fillPower(exponent);
+    for (int i = 0; i <= DistributionTable::SIZE; i++) {
+      REQUIRE(power.values[i] == Approx(std::pow(i / (float)DistributionTable::SIZE, exponent)).epsilon(1e-4).margin(1e-30));
+    }
+  }
+
+  power.fillPower(2.f);
+  power.compose(tables[DISTRIBUTION_GAUSSIAN]);
+  for (float v : {0.f, 0.3f, 0.77f, 1.f}) {
+    REQUIRE(power.lookup(v) == Approx(tables[DISTRIBUTION_GAUSSIAN].lookup(v * v)).margin(0.01));
+  }
+}
+
+TEST_CASE("Burst countdowns", "[]") {
+  DistributionTable table;
+  table.fillPower(4.f);
+  table.compose(distributionTables()[DISTRIBUTION_CLUSTERED]);
+  Xoshiro128x4 a(42);
+  Xoshiro128x4 b(42);
+  Xoshiro128x4 c(43);
+  bool differs = false;
+  for (int burst = 0; burst < 100; burst++) {
+    int32_t x[16], y[16], z[16];
+    drawCountdowns(a, table, 16, 48000.f, x);
+    drawCountdowns(b, table, 16, 48000.f, y);
+    drawCountdowns(c, table, 16, 48000.f, z);
+    for (int i = 0; i < 16; i++) {
+      REQUIRE(x[i] == y[i]);
+      REQUIRE(x[i] >= 0);
+      REQUIRE(x[i] <= 48000);
+      differs |= x[i] != z[i];
+    }
+  }
+  REQUIRE(differs);
+
+  // A burst of fewer voices draws whole groups of four from the generator
+  int32_t first[16], replay[16];
+  a.seed(7);
+  drawCountdowns(a, table, 16, 1000.f, first);
+  a.seed(7);
+  drawCountdowns(a, table, 5, 1000.f, replay);
+  for (int i = 0; i < 8; i++) {
+    REQUIRE(first[i] == replay[i]);
+  }
+
+  // A negative time gives no delay
+  drawCountdowns(a, table, 4, -100.f, first);
+  for (int i = 0; i < 4; i++) {
+    REQUIRE(first[i] == 0);
+  }
+}
+
+TEST_CASE("Sum banks", "[]") {
+  SumBanks sums;
+  for (int c = 0; c < 16; c++) {
+    sums.next()[c] = c;
+  }
+  sums.advance();
+  sums.store(0);
+
+  // Channels that weren't written carry over from the current bank
+  for (int c = 0; c < 4; c++) {
+    sums.next()[c] = 100.f + c;
+  }
+  sums.advance(4);
+  REQUIRE(sums.current()[3] == 103.f);
+  REQUIRE(sums.current()[4] == 4.f);
+  REQUIRE(sums.current()[15] == 15.f);
+  REQUIRE(sums.slot(0)[3] == 3.f);
+}
+
+TEST_CASE("Sorting network", "[]") {
+  Xoshiro128 rng(5);
+  for (int trial = 0; trial < 2000; trial++) {
+    // 1 to 16 used lanes, padded with INFINITY, with some equal values
+    int channels = 1 + trial % 16;
+    float values[16], order[16], input[16];
+    for (int c = 0; c < 16; c++) {
+      values[c] = c < channels ? std::round(rng.uniform() * 40.f) / 4.f - 5.f : INFINITY;
+      order[c] = c;
+      input[c] = values[c];
+    }
+    sort16(values, order);
+
+    float expected[16];
+    std::copy(input, input + 16, expected);
+    std::sort(expected, expected + 16);
+    bool seen[16] = {false};
+    for (int c = 0; c < 16; c++) {
+      REQUIRE(values[c] == expected[c]);
+      int channel = (int)order[c];
+      REQUIRE(!seen[channel]);
+      seen[channel] = true;
+      REQUIRE(input[channel] == values[c]);
+      REQUIRE((c < channels) == (channel < channels));
+    }
+  }
+}
+
+TEST_CASE("Half-band oversampling", "[]") {
+  // Linear phase, so the delay is the centre of mass of the impulse response
+  const int factors[] = {2, 4, 8};
+  const float upDelays[] = {16.f, 48.f, 112.f};
+  const float roundTripDelays[] = {15.f, 22.5f, 26.25f};
+  for (int k = 0; k < 3; k++) {
+    int factor = factors[k];
+    HalfBandUpsampler<float> up;
+    HalfBandDownsampler<float> down;
+    up.setFactor(factor);
+    down.setFactor(factor);
+    float buffer[8];
+
+    // DC passes at unity gain through the upsampler, and back down
+    float out = 0.f;
+    for (int n = 0; n < 200; n++) {
+      up.process(1.f, buffer);
+      if (n >= 150) {
+        for (int i = 0; i < factor; i++) {
+          REQUIRE(buffer[i] == Approx(1.f).epsilon(1e-4));
+        }
+      }
+      out = down.process(buffer);
+    }
+    REQUIRE(out == Approx(1.f).epsilon(1e-4));
+
+    // Delay in samples at the higher rate for the upsampler, and at the base rate for both
+    up.setFactor(1);
+    down.setFactor(1);
+    up.setFactor(factor);
+    down.setFactor(factor);
+    double upMoment = 0.0, upSum = 0.0, moment = 0.0, sum = 0.0;
+    for (int n = 0; n < 200; n++) {
+      up.process(n == 0 ? 1.f : 0.f, buffer);
+      for (int i = 0; i < factor; i++) {
+        upMoment += (n * factor + i) * (double)buffer[i];
+        upSum += buffer[i];
+      }
+      float y = down.process(buffer);
+      moment += n * (double)y;
+      sum += y;
+    }
+    REQUIRE(upSum / factor == Approx(1.0).epsilon(1e-4));
+    REQUIRE(upMoment / upSum == Approx(upDelays[k]).margin(1e-3));
+    REQUIRE(sum == Approx(1.0).epsilon(1e-4));
+    REQUIRE(moment / sum == Approx(roundTripDelays[k]).margin(1e-3));
+    REQUIRE(halfBandLatency(factor) == Approx(roundTripDelays[k]));
+  }
+}
+
+TEST_CASE("Zones", "[]") {
+  // Thresholds in any order, with two at the same voltage
+  const float thresholds[4] = {2.f, -1.f, 5.f, 2.f};
+  float a[16] = {-3.f, -1.f, -0.999f, 1.999f, 2.f, 4.999f, 5.f, 10.f};
+  float zones[16];
+  int active = findZones(a, 8, thresholds, 4, zones);
+  // A voltage exactly on a threshold is in the zone above it
+  const float expected[8] = {0.f, 1.f, 1.f, 1.f, 3.f, 3.f, 4.f, 4.f};
+  for (int c = 0; c < 8; c++) {
+    REQUIRE(zones[c] == expected[c]);
+  }
+  // Zone 2, between the two thresholds at 2V, is empty
+  REQUIRE(active == 0x1b);
+
+  // Channels past the count are zoned but don't set gates
+  REQUIRE(findZones(a, 1, thresholds, 4, zones) == 0x1);
+  REQUIRE(zones[7] == 4.f);
+
+  // Without thresholds everything is in zone 0
+  REQUIRE(findZones(a, 8, thresholds, 0, zones) == 0x1);
+
+  // 15 thresholds give 16 zones, which fit the gates of one cable
+  float steps[15];
+  for (int i = 0; i < 15; i++) {
+    steps[i] = i;
+  }
+  float b[16];
+  for (int c = 0; c < 16; c++) {
+    b[c] = c - 0.5f;
+  }
+  REQUIRE(findZones(b, 16, steps, 15, zones) == 0xffff);
+  for (int c = 0; c < 16; c++) {
+    REQUIRE(zones[c] == c);
+  }
+}